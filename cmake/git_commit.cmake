@@ -0,0 +1,13 @@
+# Writes the current commit to OUTPUT, run by the git_commit target on every build.
+# configure_file leaves OUTPUT untouched if the commit did not change,
+# so nothing is recompiled then.
+execute_process(COMMAND git describe --always --dirty
+                WORKING_DIRECTORY ${SOURCE_DIR}
+                OUTPUT_VARIABLE LRU_GIT_COMMIT
+                OUTPUT_STRIP_TRAILING_WHITESPACE
+                ERROR_QUIET)
+if (NOT LRU_GIT_COMMIT)
+    set(LRU_GIT_COMMIT unknown)
+endif ()
+
+configure_file(${SOURCE_DIR}/cmake/git_commit.h.in ${OUTPUT} @ONLY)
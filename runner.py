@@ -1,10 +1,12 @@
 import copy
+import csv
 import os
 import subprocess
 import sys
 from datetime import datetime
 import struct
 from pathlib import Path
+from collections import defaultdict
 from typing import Sequence, Any, Tuple, Union, List, Dict, Optional, Callable
 from termcolor import colored
 
@@ -20,6 +22,31 @@ FAST_CONTAINERS = ["lru", "concurrent", "deferred", "hhvm", "b_lru", "b_concurre
 BINNED_LRU_CONTAINERS = ALL_CONTAINERS[5:]
 DLRU_CONTAINERS = ["deferred", "b_deferred"]
 NODLRU_CONTAINERS = ["lru", "concurrent", "tbb", "hhvm", "b_lru", "b_concurrent"]
+SWISS_CONTAINERS = ["lru", "lru_swiss", "deferred", "deferred_swiss"]
+COMPACT_CONTAINERS = ["concurrent", "concurrent_compact", "deferred", "deferred_compact",
+                      "b_deferred", "b_deferred_compact"]
+SOA_CONTAINERS = ["lru", "lru_soa", "deferred_compact", "deferred_soa"]
+PLACEMENT_CONTAINERS = ["lru", "concurrent", "deferred", "deferred_compact"]
+NUMA_CONTAINERS = ["b_deferred", "numa_hash", "numa_replicated"]
+CONTENTION_CONTAINERS = ["lru", "lru_swiss", "concurrent", "deferred", "deferred_swiss",
+                         "b_deferred"]
+# --lock other than omp is built only for lru, lru_rb, concurrent, deferred, deferred_swiss,
+# b_lru and b_deferred
+LOCK_CONTAINERS = ["lru", "concurrent", "deferred", "deferred_swiss", "b_lru", "b_deferred"]
+LOCKS = ["omp", "ttas", "ticket", "mcs", "futex", "byte"]
+FC_CONTAINERS = ["lru", "lru_fc", "b_lru", "deferred"]
+# run with --lock bravo, lru_rb needs a lock with a shared mode
+READ_BUFFER_CONTAINERS = ["lru", "lru_rb", "b_lru", "deferred"]
+PROMOTION_CONTAINERS = ["lru", "concurrent", "deferred", "b_lru", "b_deferred"]
+PROMOTION_SAMPLING = [(1, 1), (0.5, 1), (0.25, 1), (0.1, 1), (0.05, 1), (0.01, 1),
+                      (1, 2), (1, 4), (1, 8), (1, 16)]
+YOUNG_CONTAINERS = ["concurrent", "concurrent_compact"]
+HOT_KEY_CONTAINERS = ["concurrent", "deferred", "deferred_swiss", "b_deferred"]
+HOT_KEY_LOCKS = ["omp", "ttas", "rw", "bravo"]
+SHARDED_CONTAINERS = ["b_lru", "b_concurrent", "b_deferred", "b_deferred_compact"]
+SHARD_COUNTS = [0, 1, 4, 16, 64, 256]
+DLRU_VARIANTS = DLRU_CONTAINERS + ["deferred_swiss", "deferred_compact", "b_deferred_compact",
+                                   "deferred_soa", "numa_hash", "numa_replicated"]
 CURRENT_TEST = 'NA'
 
 
@@ -37,6 +64,9 @@ def main():
     benchmarks = {
         'speedup': (lambda start: scalability(start, traces_main, capacity_main,
                                               threads_full, FAST_CONTAINERS, pull_push)),
+        'speedup_pinned': (lambda start: scalability(start, traces_main, capacity_main, threads_full,
+                                                     FAST_CONTAINERS, pull_push, pin='scatter',
+                                                     avoid_smt=True)),
         'speedup96': (lambda start: scalability(start, traces_main, capacity_main,
                                                 threads_96, BINNED_LRU_CONTAINERS, pull_push)),
         'perf': (lambda start: scalability(start, traces_all, capacity_main,
@@ -45,11 +75,46 @@ def main():
                                                   threads_main, NODLRU_CONTAINERS, pull_push)),
         'perf_dlru': (lambda start: scalability(start, traces_all, capacity_main,
                                                 threads_main, DLRU_CONTAINERS, pull_push)),
+        'swiss': (lambda start: scalability(start, traces_main, capacity_main,
+                                            threads_full, SWISS_CONTAINERS, pull_push)),
+        'compact': (lambda start: scalability(start, traces_main, capacity_main,
+                                              threads_full, COMPACT_CONTAINERS, pull_push)),
+        'soa': (lambda start: scalability(start, traces_main, capacity_main,
+                                          threads_full, SOA_CONTAINERS, pull_push)),
+        'placement': (lambda start: placement(start, traces_main, capacity_main, threads_full,
+                                              PLACEMENT_CONTAINERS,
+                                              [('default', 'default'), ('thp', 'default'),
+                                               ('2m', 'default'), ('default', 'interleave'),
+                                               ('default', 'first-touch'), ('2m', 'interleave'),
+                                               ('2m', 'first-touch')])),
+        'numa': (lambda start: scalability(start, traces_main, capacity_main,
+                                           threads_full, NUMA_CONTAINERS, pull_push, pin='per-socket')),
+        'contention': (lambda start: scalability(start, traces_main, capacity_main, threads_main,
+                                                 CONTENTION_CONTAINERS, pull_push, profile=True)),
+        'locks': (lambda start: locks(start, traces_main, capacity_main, threads_full,
+                                      LOCK_CONTAINERS, LOCKS)),
+        'flat_combining': (lambda start: scalability(start, traces_main, capacity_main,
+                                                     threads_full + threads_96[1:], FC_CONTAINERS,
+                                                     pull_push)),
+        'read_buffer': (lambda start: scalability(start, traces_main, capacity_main,
+                                                  threads_full + threads_96[1:],
+                                                  READ_BUFFER_CONTAINERS, pull_push,
+                                                  lock='bravo')),
+        'promotion': (lambda start: promotion(start, traces_main, capacity_main, threads_main,
+                                              PROMOTION_CONTAINERS, PROMOTION_SAMPLING)),
+        'young': (lambda start: young(start, traces_main, capacity_main, threads_main,
+                                      YOUNG_CONTAINERS, [0, 0.05, 0.1, 0.25, 0.5])),
+        'shards': (lambda start: shards(start, traces_main, capacity_main, threads_full,
+                                        SHARDED_CONTAINERS, SHARD_COUNTS)),
+        'hot_keys': (lambda start: hot_keys(start, [16, 256, 4096], threads_full,
+                                            HOT_KEY_CONTAINERS, HOT_KEY_LOCKS)),
         'meta': (lambda start: meta_parameters(start, traces_main, capacity_main, threads_short, True,
                                                [0.001, 0.01, 0.1, 0.4, 0.7, 0.9],
                                                [0.001, 0.01, 0.1, 0.4, 0.7, 0.9])),
         'meta2': (lambda start: meta_parameters(start, traces_main, capacity_main, threads_short, False,
                                                 [0.75, 0.8, 0.9, 0.99], [0.75, 0.8, 0.9, 0.99])),
+        'recent_shards': (lambda start: recent_shards(start, traces_main, capacity_main, threads_96,
+                                                      [1, 4, 16, 64])),
         'preflight': (lambda start: preflight_check(start, traces_all, ALL_CONTAINERS))
     }
 
@@ -82,20 +147,22 @@ def main():
 
 def metaparam_filter(e: Dict) -> bool:
     try:
-        if e['backend'] in DLRU_CONTAINERS:
+        if e['backend'] in DLRU_VARIANTS:
             return e['pull_threshold'] != 0 and e['purge_threshold'] != 0
         return e['pull_threshold'] == 0 or e['purge_threshold'] == 0
     except KeyError:
         return True
 
 
-def scalability(start, traces, capacity_factors, threads, containers, pull_purge, reps=3, log_file=None):
+def scalability(start, traces, capacity_factors, threads, containers, pull_purge, reps=3, log_file=None,
+                pin='none', avoid_smt=False, profile=True, lock='omp'):
     if log_file is None:
         log_file = CURRENT_TEST + '.csv'
 
     print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
 
-    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000)
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000, pin=pin,
+                       avoid_smt=avoid_smt, profile=profile)
     trace_worklist = generate_trace_worklist(traces, capacity_factors)
 
     app.run([
@@ -106,7 +173,9 @@ def scalability(start, traces, capacity_factors, threads, containers, pull_purge
         ('time_limit', [20])
     ], 0)
 
+    # the dummy backend above is built with the default lock only
     app.time_limit = TIME_LIMIT
+    app.lock = lock
     app.run([
         ('reps', list(range(reps))),
         (('generator', 'capacity'), trace_worklist),
@@ -116,6 +185,196 @@ def scalability(start, traces, capacity_factors, threads, containers, pull_purge
     ], start, metaparam_filter)
 
 
+def recent_shards(start, traces, capacity_factors, threads, shard_counts, reps=2, log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000,
+                       pull_threshold=0.1, purge_threshold=0.7)
+    trace_worklist = generate_trace_worklist(traces, capacity_factors)
+
+    app.time_limit = TIME_LIMIT
+    for shards in shard_counts:
+        app.run_info = f'{VERSION}-rs{shards}'
+        app.run([
+            ('reps', list(range(reps))),
+            (('generator', 'capacity'), trace_worklist),
+            ('threads', threads),
+            ('backend', DLRU_CONTAINERS),
+            ('recent_shards', [shards])
+        ], start)
+
+
+def placement(start, traces, capacity_factors, threads, containers, placements, reps=2, log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000,
+                       pull_threshold=0.1, purge_threshold=0.7)
+    trace_worklist = generate_trace_worklist(traces, capacity_factors)
+
+    app.time_limit = TIME_LIMIT
+    for pages, numa in placements:
+        app.run_info = f'{VERSION}-{pages}-{numa}'
+        app.run([
+            ('reps', list(range(reps))),
+            (('generator', 'capacity'), trace_worklist),
+            ('threads', threads),
+            ('backend', containers),
+            ('pages', [pages]),
+            ('numa', [numa])
+        ], start)
+
+
+def locks(start, traces, capacity_factors, threads, containers, lock_types, reps=2, log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000,
+                       pull_threshold=0.1, purge_threshold=0.7)
+    trace_worklist = generate_trace_worklist(traces, capacity_factors)
+
+    app.time_limit = TIME_LIMIT
+    app.run([
+        ('reps', list(range(reps))),
+        (('generator', 'capacity'), trace_worklist),
+        ('threads', threads),
+        ('backend', containers),
+        ('lock', lock_types)
+    ], start)
+
+
+def promotion(start, traces, capacity_factors, threads, containers, sampling, reps=2,
+              log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000,
+                       pull_threshold=0.1, purge_threshold=0.7)
+    trace_worklist = generate_trace_worklist(traces, capacity_factors)
+
+    app.time_limit = TIME_LIMIT
+    app.run([
+        ('reps', list(range(reps))),
+        (('generator', 'capacity'), trace_worklist),
+        ('threads', threads),
+        ('backend', containers),
+        (('promotion_probability', 'promote_every'), sampling)
+    ], start)
+
+    pareto_frontier(log_file)
+
+
+def pareto_frontier(log_file):
+    """Prints (and plots, if matplotlib is available) hit rate vs throughput
+    of every promotion policy and marks the policies no other one beats on both."""
+    runs = defaultdict(lambda: defaultdict(list))
+    with open(log_file) as f:
+        for row in csv.DictReader(f, skipinitialspace=True):
+            key = (row['trace'], row['container'], row['capacity'], row['threads'])
+            runs[key][row['promotion']].append((float(row['hit_rate']), float(row['throughput'])))
+
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+    except ImportError:
+        plt = None
+
+    for key, policies in runs.items():
+        points = {policy: (sum(h for h, _ in v) / len(v), sum(t for _, t in v) / len(v))
+                  for policy, v in policies.items()}
+        frontier = [p for p, (h, t) in points.items()
+                    if not any(h2 >= h and t2 >= t and (h2, t2) != (h, t) for h2, t2 in points.values())]
+
+        print(colored(' / '.join(key), 'green', attrs=['bold']))
+        for policy, (h, t) in sorted(points.items(), key=lambda x: x[1][1]):
+            mark = '*' if policy in frontier else ' '
+            print(f'  {mark} {policy:>20}: hit rate {h * 100:7.3f}%, throughput {t / 1e6:8.3f} MOp/s')
+
+        if plt is not None:
+            fig, ax = plt.subplots()
+            for policy, (h, t) in points.items():
+                ax.scatter(t / 1e6, h * 100, color='red' if policy in frontier else 'gray')
+                ax.annotate(policy, (t / 1e6, h * 100), fontsize=7)
+            ax.set_xlabel('throughput, MOp/s')
+            ax.set_ylabel('hit rate, %')
+            ax.set_title(' / '.join(key))
+            name = '_'.join(Path(k).name for k in key)
+            fig.savefig(f'{Path(log_file).stem}_{name}.png')
+            plt.close(fig)
+
+
+def young(start, traces, capacity_factors, threads, containers, fractions, reps=2, log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000)
+    trace_worklist = generate_trace_worklist(traces, capacity_factors)
+
+    app.time_limit = TIME_LIMIT
+    app.run([
+        ('reps', list(range(reps))),
+        (('generator', 'capacity'), trace_worklist),
+        ('threads', threads),
+        ('backend', containers),
+        ('young_fraction', fractions)
+    ], start)
+
+
+def shards(start, traces, capacity_factors, threads, containers, shard_counts, reps=2,
+           log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    # Shard count 0 is the automatic choice by thread count and capacity
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000,
+                       pull_threshold=0.1, purge_threshold=0.7)
+    trace_worklist = generate_trace_worklist(traces, capacity_factors)
+
+    app.time_limit = TIME_LIMIT
+    app.run([
+        ('reps', list(range(reps))),
+        (('generator', 'capacity'), trace_worklist),
+        ('threads', threads),
+        ('backend', containers),
+        ('shards', shard_counts)
+    ], start)
+
+
+def hot_keys(start, max_keys, threads, containers, lock_types, reps=2, log_file=None):
+    if log_file is None:
+        log_file = CURRENT_TEST + '.csv'
+
+    print(f'{"#" * 25}\n#### {CURRENT_TEST:^15} ####\n{"#" * 25}')
+
+    # Capacity holds every key, so the runs measure hits on a few hot buckets
+    app = BenchmarkApp(log_file=log_file, run_info=VERSION, print_freq=1000000,
+                       generator='normal', capacity=100000,
+                       pull_threshold=0.1, purge_threshold=0.7)
+
+    app.time_limit = TIME_LIMIT
+    app.run([
+        ('reps', list(range(reps))),
+        ('max_key', max_keys),
+        ('threads', threads),
+        ('backend', containers),
+        ('lock', lock_types)
+    ], start)
+
+
 def preflight_check(start, traces, containers, log_file=None):
     if log_file is None:
         log_file = CURRENT_TEST + '.csv'
@@ -225,15 +484,31 @@ class BenchmarkApp:
                  payload_level=1,
                  threads=1,
                  limit_max_key=False,
+                 max_key=0,
                  is_item_capacity=True,
                  capacity=100,
                  pull_threshold=0.7,
                  purge_threshold=0.7,
+                 young_fraction=0,
+                 promotion_probability=1,
+                 promote_every=1,
+                 recent_shards=1,
+                 shards=0,
+                 resize_to=0,
+                 prefill=False,
+                 warmup=None,
+                 series=None,
+                 json_log=None,
                  verbose=True,
                  print_freq=50000,
                  time_limit=TIME_LIMIT,
                  reps=3,
-                 profile=True):
+                 profile=True,
+                 pages='default',
+                 numa='default',
+                 pin='none',
+                 avoid_smt=False,
+                 lock='omp'):
         if run_name is None:
             run_name = get_run_name()
         self.app_path = app_path
@@ -245,15 +520,31 @@ class BenchmarkApp:
         self.payload_level = payload_level
         self.threads = threads
         self.limit_max_key = limit_max_key
+        self.max_key = max_key
         self.is_item_capacity = is_item_capacity
         self.capacity = capacity
         self.pull_threshold = pull_threshold
         self.purge_threshold = purge_threshold
+        self.young_fraction = young_fraction
+        self.promotion_probability = promotion_probability
+        self.promote_every = promote_every
+        self.recent_shards = recent_shards
+        self.shards = shards
+        self.resize_to = resize_to
+        self.prefill = prefill
+        self.warmup = warmup
+        self.series = series
+        self.json_log = json_log
         self.verbose = verbose
         self.print_freq = print_freq
         self.time_limit = time_limit
         self.reps = reps
         self.profile = profile
+        self.pages = pages
+        self.numa = numa
+        self.pin = pin
+        self.avoid_smt = avoid_smt
+        self.lock = lock
         print(colored(f'{log_file}|{run_name}|{run_info}', 'green', attrs=['bold']))
 
     def run(self, overrides: Sequence[Union[SimpleOverride, CompoundOverride]] = None, start=0,
@@ -322,15 +613,48 @@ class BenchmarkApp:
                 '-p', self.payload_level,
                 '--pull-thrs', self.pull_threshold,
                 '--purge-thrs', self.purge_threshold,
-                '--time-limit', self.time_limit
+                '--young-fraction', self.young_fraction,
+                '--promotion-probability', self.promotion_probability,
+                '--promote-every', self.promote_every,
+                '--recent-shards', self.recent_shards,
+                '--time-limit', self.time_limit,
+                '--pages', self.pages,
+                '--numa', self.numa,
+                '--pin', self.pin,
+                '--lock', self.lock
                 ]
         if self.limit_max_key:
             args.append('--fix-max-key')
             args.append('1')
 
+        if self.max_key:
+            args.append('--max-key')
+            args.append(self.max_key)
+
+        if self.shards:
+            args.append('--shards')
+            args.append(self.shards)
+        if self.resize_to:
+            args.append('--resize-to')
+            args.append(self.resize_to)
+        if self.prefill:
+            args.append('--prefill')
+        if self.warmup:
+            args.append('--warmup')
+            args.append(self.warmup)
+        if self.series:
+            args.append('--series')
+            args.append(self.series)
+        if self.json_log:
+            args.append('--json-log')
+            args.append(self.json_log)
+
         if self.profile:
             args.append('--profile')
 
+        if self.avoid_smt:
+            args.append('--avoid-smt')
+
         args = [str(a) for a in args]
         print('  >> ' + ' '.join(args))
 
@@ -4,8 +4,14 @@
 // Created by metopa on 20/03/19.
 //
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
 #include <containers/bucketed_adapter.h>
 
 #include "CLI11.hpp"
@@ -16,10 +22,17 @@
 #include "containers/dummy.h"
 #include "containers/hash_fixed.h"
 #include "containers/hhvm_lru.h"
+#include "containers/node_array.h"
+#include "containers/numa_sharded_adapter.h"
 #include "containers/tbb_hash.h"
 #include "containers/tbb_lru.h"
 #include "csv_logger.h"
+#include "json_logger.h"
+#include "locks.h"
+#include "perf_counters.h"
 #include "random_key_generator.h"
+#include "time_series.h"
+#include "topology.h"
 
 class Payload {
   public:
@@ -39,13 +52,149 @@ class Payload {
     uint64_t     user_data_;
 };
 
+template <typename Container, typename = void>
+struct HasNumaAccessStats : std::false_type {};
+
+template <typename Container>
+struct HasNumaAccessStats<Container,
+                          std::void_t<decltype(std::declval<Container&>().accessStats())>>
+    : std::true_type {};
+
+template <typename Container, typename = void>
+struct HasResize : std::false_type {};
+
+template <typename Container>
+struct HasResize<Container,
+                 std::void_t<decltype(std::declval<Container&>().resize(size_t(), bool()))>>
+    : std::true_type {};
+
+using prefill_pair_t = std::pair<lru_key_t, lru_value_t>;
+
+template <typename Container, typename = void>
+struct HasBulkLoad : std::false_type {};
+
+template <typename Container>
+struct HasBulkLoad<Container, std::void_t<decltype(std::declval<Container&>().bulkLoad(
+                                  std::declval<prefill_pair_t*>(),
+                                  std::declval<prefill_pair_t*>(), unsigned()))>>
+    : std::true_type {};
+
+template <typename Container, typename = void>
+struct HasSnapshot : std::false_type {};
+
+template <typename Container>
+struct HasSnapshot<Container,
+                   std::void_t<decltype(std::declval<Container&>().loadSnapshot(std::string()))>>
+    : std::true_type {};
+
+template <typename Container, typename = void>
+struct HasLockProfile : std::false_type {};
+
+template <typename Container>
+struct HasLockProfile<Container, std::void_t<decltype(std::declval<Container&>().lockProfile())>>
+    : std::true_type {};
+
+/// Lock contention of the container, disabled unless it is compiled with profiling
+template <typename Container>
+LockProfileReport lockProfileOf(const Container& cont) {
+    if constexpr (HasLockProfile<Container>::value) {
+        return cont.lockProfile();
+    } else {
+        return {};
+    }
+}
+
+/// Prints lock contention of the container if it is compiled with profiling
+template <typename Container>
+void printLockProfile(const Container& cont) {
+    lockProfileOf(cont).print(std::cout, "Lock profile: ");
+}
+
+/// Changes the capacity while the other threads keep running
+template <typename Container>
+void resizeContainer(Container& cont, size_t capacity, bool is_item_capacity) {
+    if constexpr (HasResize<Container>::value) {
+        auto start = std::chrono::steady_clock::now();
+        cont.resize(capacity, is_item_capacity);
+        std::chrono::duration<double> dur = std::chrono::steady_clock::now() - start;
+        std::cout << "\nResized to " << cont.memStats().capacity << " elements in "
+                  << dur.count() * 1000 << " ms" << std::endl;
+    }
+}
+
+/// Bulk loads keys [0, count) with the values the benchmark expects for them
+template <typename Container>
+void prefillContainer(Container& cont, size_t count, uint64_t payload, unsigned threads) {
+    if constexpr (HasBulkLoad<Container>::value) {
+        std::vector<prefill_pair_t> pairs(count);
+        for (size_t key = 0; key < count; key++) {
+            pairs[key] = {key, lru_value_t{{payload, key}}};
+        }
+
+        auto   start  = std::chrono::steady_clock::now();
+        size_t loaded = cont.bulkLoad(pairs.data(), pairs.data() + count, threads);
+
+        std::chrono::duration<double> dur = std::chrono::steady_clock::now() - start;
+        std::cout << "Prefilled " << loaded << " elements in " << dur.count() * 1000 << " ms"
+                  << std::endl;
+    }
+}
+
+/// @return time it took to write the snapshot
+template <typename Container>
+std::chrono::duration<double> saveSnapshot(Container& cont, const std::string& path) {
+    std::chrono::duration<double> dur{0};
+    if constexpr (HasSnapshot<Container>::value) {
+        auto   start = std::chrono::steady_clock::now();
+        size_t count = cont.saveSnapshot(path);
+        dur          = std::chrono::steady_clock::now() - start;
+        std::cout << "Saved " << count << " elements to " << path << " in " << dur.count() * 1000
+                  << " ms" << std::endl;
+    }
+    return dur;
+}
+
+template <typename Container>
+void loadSnapshot(Container& cont, const std::string& path) {
+    if constexpr (HasSnapshot<Container>::value) {
+        auto   start = std::chrono::steady_clock::now();
+        size_t count = cont.loadSnapshot(path);
+
+        std::chrono::duration<double> dur = std::chrono::steady_clock::now() - start;
+        std::cout << "Warmed up from " << path << " (" << count << " elements) in "
+                  << dur.count() * 1000 << " ms" << std::endl;
+    }
+}
+
 template <typename Container>
 void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int time_limit);
 
 RandomBenchmarkApp::RandomBenchmarkApp()
-    : app(help(), "LRU Benchmark"), payload_level(5), threads(1),
-      limit_max_key(false), is_item_capacity(false), capacity(0), pull_threshold(0.1),
-      purge_threshold(0.1), verbose(false), print_freq(1000), time_limit(60), profile(false) {
+    : app(help(), "LRU Benchmark"),
+      payload_level(5),
+      threads(1),
+      limit_max_key(false),
+      max_key(0),
+      is_item_capacity(false),
+      capacity(0),
+      pull_threshold(0.1),
+      purge_threshold(0.1),
+      young_fraction(0),
+      recent_shards(1),
+      shards(0),
+      resize_to(0),
+      prefill(false),
+      warmup("none"),
+      series_dt(1),
+      verbose(false),
+      print_freq(1000),
+      time_limit(60),
+      profile(false),
+      pages("default"),
+      numa("default"),
+      pin("none"),
+      avoid_smt(false),
+      lock("omp") {
     app.add_option("--log-file,-L", log_file)->required();
     app.add_option("--name,-N", run_name)->required();
     app.add_option("--info,-I", run_info);
@@ -53,7 +202,10 @@ RandomBenchmarkApp::RandomBenchmarkApp()
     app.add_flag("--verbose,-v", verbose);
     app.add_set_ignore_case("--backend,-B", backend,
                             {"dummy", "hash", "lru", "concurrent", "deferred", "tbb", "tbb_hash",
-                             "hhvm", "b_lru", "b_concurrent", "b_deferred"})
+                             "hhvm", "b_lru", "b_concurrent", "b_deferred", "lru_swiss",
+                             "deferred_swiss", "concurrent_compact", "deferred_compact",
+                             "b_deferred_compact", "lru_soa", "deferred_soa", "numa_hash",
+                             "numa_replicated", "lru_fc", "lru_rb"})
         ->required();
     app.add_option("--threads,-t", threads, "", true)->default_val("1");
     auto c = app.add_option("--capacity, -c", capacity);
@@ -70,10 +222,48 @@ RandomBenchmarkApp::RandomBenchmarkApp()
     app.add_option("--print-freq,-q", print_freq);
     app.add_option("--payload,-p", payload_level);
     app.add_option("--fix-max-key", limit_max_key);
+    app.add_option("--max-key", max_key, "Largest generated key, small values make hot keys");
     app.add_option("--pull-thrs", pull_threshold);
     app.add_option("--purge-thrs", purge_threshold);
+    app.add_option("--young-fraction", young_fraction,
+                   "ConcurrentLRU hits don't promote nodes in this youngest part of the list");
+    app.add_option("--promotion-probability", promotion_sampling.probability,
+                   "Share of hits that are promoted (LRU, concurrent and deferred backends)");
+    app.add_option("--promote-every", promotion_sampling.every_nth,
+                   "Promote only every Nth hit of a thread");
+    app.add_option("--recent-shards", recent_shards);
+    app.add_option("--shards", shards,
+                   "Shards of the b_* backends, 0 chooses them by thread count and capacity");
+    app.add_option("--resize-to", resize_to,
+                   "Capacity (in -c or -m units) set while the run is halfway through");
+    app.add_flag("--prefill", prefill,
+                 "Bulk load all keys the generator can produce (up to the capacity) before the "
+                 "run (deferred and concurrent backends)");
+    app.add_option("--warmup", warmup,
+                   "Untimed phase before the run: none, <seconds>s, <operations> or full "
+                   "(as many misses as the cache holds, at most --time-limit seconds)",
+                   true);
+    app.add_option("--series", series,
+                   "Append throughput, hit rate, evictions and memory of every --series-interval "
+                   "to this CSV (JSON lines if it ends in .jsonl)");
+    app.add_option("--series-interval", series_dt, "Seconds between --series samples", true);
+    app.add_option("--json-log", json_log,
+                   "Also append the run with its whole configuration to this JSON lines file");
     app.add_option("--time-limit", time_limit);
     app.add_flag("--profile", profile);
+    app.add_set_ignore_case("--pages", pages, {"default", "thp", "2m", "1g"},
+                            "Page size backing container node arrays");
+    app.add_set_ignore_case("--numa", numa, {"default", "interleave", "first-touch"},
+                            "NUMA placement of container node arrays");
+    app.add_set_ignore_case("--pin", pin, {"none", "compact", "scatter", "per-socket", "list"},
+                            "Affinity of benchmark threads");
+    app.add_option("--pin-cpus", pin_cpus, "CPU list for --pin list, e.g. 0-7,16-23");
+    app.add_flag("--avoid-smt", avoid_smt, "Pin to one SMT sibling per core");
+    app.add_set_ignore_case("--lock", lock,
+                            {"omp", "ttas", "ticket", "mcs", "futex", "byte", "rw", "bravo"},
+                            "Lock type of the containers (ContainerConfig::locking_t), other "
+                            "than omp only for lru, lru_rb, concurrent, deferred, deferred_swiss, "
+                            "b_lru and b_deferred. lru_rb needs rw or bravo");
 }
 
 const char* RandomBenchmarkApp::help() {
@@ -87,56 +277,299 @@ int RandomBenchmarkApp::parse(int argc, char** argv) {
     } catch (const CLI::ParseError& e) {
         return app.exit(e);
     };
+    return 0;
+}
+
+/// Hit promotion policy for the CSV, e.g. "always", "p=0.25" or "young<0.25+every=4"
+static std::string describePromotion(double young_fraction, const PromotionSampling& sampling) {
+    if (young_fraction <= 0) {
+        return sampling.describe();
+    }
+    std::ostringstream out;
+    out << "young<" << young_fraction;
+    if (!sampling.isDefault()) {
+        out << "+" << sampling.describe();
+    }
+    return out.str();
+}
+
+std::string RandomBenchmarkApp::promotion() const {
+    return describePromotion(young_fraction, promotion_sampling);
 }
 
-void RandomBenchmarkApp::run() { runImpl<false>(); }
+/// Every option of the random benchmark for the JSON log
+static JsonObject describeConfig(const RandomBenchmarkApp& b) {
+    JsonObject config;
+    config.add("log_file", b.log_file)
+        .add("run_name", b.run_name)
+        .add("run_info", b.run_info)
+        .add("generator", b.generator)
+        .add("backend", b.backend)
+        .add("payload_level", b.payload_level)
+        .add("threads", b.threads)
+        .add("limit_max_key", b.limit_max_key)
+        .add("max_key", b.max_key)
+        .add("is_item_capacity", b.is_item_capacity)
+        .add("capacity", b.capacity)
+        .add("pull_threshold", b.pull_threshold)
+        .add("purge_threshold", b.purge_threshold)
+        .add("young_fraction", b.young_fraction)
+        .add("promotion_probability", b.promotion_sampling.probability)
+        .add("promote_every", b.promotion_sampling.every_nth)
+        .add("recent_shards", b.recent_shards)
+        .add("shards", b.shards)
+        .add("resize_to", b.resize_to)
+        .add("prefill", b.prefill)
+        .add("warmup", b.warmup)
+        .add("series", b.series)
+        .add("series_interval", b.series_dt)
+        .add("profile", b.profile)
+        .add("print_freq", b.print_freq)
+        .add("time_limit", b.time_limit)
+        .add("pages", b.pages)
+        .add("numa", b.numa)
+        .add("pin", b.pin)
+        .add("pin_cpus", b.pin_cpus)
+        .add("avoid_smt", b.avoid_smt)
+        .add("lock", b.lock);
+    return config;
+}
+
+/// Every option of the trace benchmark for the JSON log
+static JsonObject describeConfig(const TraceBenchmarkApp& b) {
+    JsonObject config;
+    config.add("log_file", b.log_file)
+        .add("trace_file", b.trace_file)
+        .add("backend", b.backend)
+        .add("iterations", b.iterations)
+        .add("capacity", b.capacity)
+        .add("pull_threshold", b.pull_threshold)
+        .add("purge_threshold", b.purge_threshold)
+        .add("young_fraction", b.young_fraction)
+        .add("promotion_probability", b.promotion_sampling.probability)
+        .add("promote_every", b.promotion_sampling.every_nth)
+        .add("recent_shards", b.recent_shards)
+        .add("shards", b.shards)
+        .add("snapshot", b.snapshot)
+        .add("warmup", b.warmup)
+        .add("series", b.series)
+        .add("series_interval", b.series_dt);
+    return config;
+}
+
+WarmupPhase WarmupPhase::parse(const std::string& s) {
+    WarmupPhase phase;
+    size_t      digits = s.find_first_not_of("0123456789.");
+    if (s == "none") {
+        phase.kind = Kind::None;
+    } else if (s == "pass") {
+        phase.kind = Kind::Pass;
+    } else if (s == "full") {
+        phase.kind = Kind::Full;
+    } else if (digits == s.size() - 1 && digits > 0 && s.back() == 's') {
+        phase.kind    = Kind::Time;
+        phase.seconds = std::stod(s);
+    } else if (digits == std::string::npos && !s.empty() && s.find('.') == std::string::npos) {
+        phase.kind = Kind::Ops;
+        phase.ops  = std::stoull(s);
+    } else {
+        throw std::runtime_error("Unknown warm-up: " + s);
+    }
+    return phase;
+}
+
+bool WarmupPhase::isOver(size_t done_ops, size_t misses, double elapsed, size_t fill_count) const {
+    switch (kind) {
+    case Kind::Time:
+        return elapsed >= seconds;
+    case Kind::Ops:
+        return done_ops >= ops;
+    case Kind::Full:
+        return misses >= fill_count;
+    default:
+        return true;
+    }
+}
+
+std::string WarmupPhase::describe() const {
+    switch (kind) {
+    case Kind::Pass:
+        return "pass";
+    case Kind::Time: {
+        std::ostringstream out;
+        out << seconds << "s";
+        return out.str();
+    }
+    case Kind::Ops:
+        return std::to_string(ops) + " ops";
+    case Kind::Full:
+        return "full";
+    default:
+        return "none";
+    }
+}
+
+void RandomBenchmarkApp::run() {
+    if (profile) {
+        runWithLock<true>();
+    } else {
+        runWithLock<false>();
+    }
+}
 
 template <bool EnableProfile>
+void RandomBenchmarkApp::runWithLock() {
+    if (lock == "omp") {
+        runImpl<EnableProfile, OpenMPLock>();
+    } else if (lock == "ttas") {
+        runImpl<EnableProfile, TTASLock>();
+    } else if (lock == "ticket") {
+        runImpl<EnableProfile, TicketLock>();
+    } else if (lock == "mcs") {
+        runImpl<EnableProfile, MCSLock>();
+    } else if (lock == "futex") {
+        runImpl<EnableProfile, FutexLock>();
+    } else if (lock == "byte") {
+        runImpl<EnableProfile, ByteLock>();
+    } else if (lock == "rw") {
+        runImpl<EnableProfile, RWSpinLock>();
+    } else if (lock == "bravo") {
+        runImpl<EnableProfile, BravoRWLock>();
+    } else {
+        std::cerr << "Unknown lock: " << lock << std::endl;
+    }
+}
+
+/**
+ * Runs the backends that use ContainerConfig::locking_t, only these are built for every --lock.
+ * @return false if the backend is not one of them
+ */
+template <typename Config>
+static bool runLockSweepBackend(RandomBenchmarkApp& b, CsvLogger& l) {
+    if (b.backend == "lru") {
+        LRUCache<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "lru_rb") {
+        if constexpr (SupportsSharedLock<typename Config::locking_t>::value) {
+            LRUCache<Config, 0, false, false, LruListSync::ReadBuffer> lru(b.capacity,
+                                                                           b.is_item_capacity);
+            benchmark(b, lru, l, b.time_limit);
+        } else {
+            throw std::runtime_error("Backend lru_rb needs a lock with a shared mode, --lock rw "
+                                     "or bravo");
+        }
+    } else if (b.backend == "concurrent") {
+        ConcurrentLRU<Config> lru(b.capacity, b.is_item_capacity, b.young_fraction);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "deferred") {
+        DeferredLRU<Config> lru(b.capacity, b.is_item_capacity, b.pull_threshold, b.purge_threshold,
+                                b.recent_shards);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "deferred_swiss") {
+        DeferredLRU<Config, true> lru(b.capacity, b.is_item_capacity, b.pull_threshold,
+                                      b.purge_threshold, b.recent_shards);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "b_lru") {
+        BucketedLRU<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "b_deferred") {
+        BucketedDeferredLRU<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/// Runs the remaining backends, which are built with the default lock only
+template <typename Config>
+static void runDefaultLockBackend(RandomBenchmarkApp& b, CsvLogger& l) {
+    if (b.backend == "dummy") {
+        DummyCache<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "hash") {
+        HashFixed<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "tbb") {
+        TbbLRU<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "tbb_hash") {
+        TbbHash<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "hhvm") {
+        HhvmLRU<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "b_concurrent") {
+        BucketedConcurrentLRU<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "lru_swiss") {
+        LRUCache<Config, 0, true> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "concurrent_compact") {
+        ConcurrentLRU<Config, 0, uint32_t> lru(b.capacity, b.is_item_capacity, b.young_fraction);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "deferred_compact") {
+        DeferredLRU<Config, false, uint32_t> lru(b.capacity, b.is_item_capacity, b.pull_threshold,
+                                                 b.purge_threshold, b.recent_shards);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "b_deferred_compact") {
+        BucketedCompactDeferredLRU<Config> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "lru_soa") {
+        LRUCache<Config, 0, false, true> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "deferred_soa") {
+        DeferredLRU<Config, false, uint32_t, true> lru(b.capacity, b.is_item_capacity,
+                                                       b.pull_threshold, b.purge_threshold,
+                                                       b.recent_shards);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "numa_hash") {
+        NumaDeferredLRU<Config, NumaRouting::KeyHash> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "numa_replicated") {
+        NumaDeferredLRU<Config, NumaRouting::ReplicateHot> lru(b.capacity, b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else if (b.backend == "lru_fc") {
+        LRUCache<Config, 0, false, false, LruListSync::FlatCombining> lru(b.capacity,
+                                                                          b.is_item_capacity);
+        benchmark(b, lru, l, b.time_limit);
+    } else {
+        throw std::runtime_error("Unknown backend: " + b.backend);
+    }
+}
+
+template <bool EnableProfile, typename LockT>
 void RandomBenchmarkApp::runImpl() {
     try {
         using config_t = ContainerConfig<lru_key_t, lru_value_t, std::hash<lru_key_t>, std::less<>,
-                                         OpenMPLock, EmptyDeletePolicy, 4, false, EnableProfile>;
+                                         LockT, EmptyDeletePolicy, 4, false, EnableProfile>;
 
         CsvLogger l(log_file, verbose);
 
+        NodePlacement& placement = NodePlacement::global();
+        placement.pages          = NodePlacement::parsePages(pages);
+        placement.numa           = NodePlacement::parseNuma(numa);
+        placement.touch_threads  = threads;
+
+        // node arrays reserve room for the resize, whole multiples leave slack for rounding
+        placement.max_growth = std::max(1., std::ceil(double(resize_to) / capacity));
+
+        ShardSizing& sharding = ShardSizing::global();
+        sharding.shards       = shards;
+        sharding.threads      = threads;
+
+        PromotionSampling::global() = promotion_sampling;
+
         volatile size_t tmp = capacity;
         capacity            = tmp;
 
-        if (backend == "dummy") {
-            DummyCache<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "hash") {
-            HashFixed<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "lru") {
-            LRUCache<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "concurrent") {
-            ConcurrentLRU<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "deferred") {
-            DeferredLRU<config_t> lru(capacity, is_item_capacity, pull_threshold, purge_threshold);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "tbb") {
-            TbbLRU<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "tbb_hash") {
-            TbbHash<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "hhvm") {
-            HhvmLRU<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "b_lru") {
-            BucketedLRU<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "b_concurrent") {
-            BucketedConcurrentLRU<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
-        } else if (backend == "b_deferred") {
-            BucketedDeferredLRU<config_t> lru(capacity, is_item_capacity);
-            benchmark(*this, lru, l, time_limit);
+        if (runLockSweepBackend<config_t>(*this, l)) {
+            return;
+        }
+        if constexpr (std::is_same<LockT, OpenMPLock>::value) {
+            runDefaultLockBackend<config_t>(*this, l);
         } else {
-            throw std::runtime_error("Unknown backend: " + backend);
+            throw std::runtime_error("Backend " + backend + " supports only --lock omp");
         }
     } catch (std::runtime_error& e) {
         std::cerr << e.what() << std::endl;
@@ -152,10 +585,47 @@ void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int ti
         b.is_item_capacity
             ? cont.memStats().capacity
             : (cont.memStats().total_mem / (sizeof(lru_key_t) + sizeof(lru_value_t)));
-    auto max_key = cont.memStats().capacity / 100 * 99;
+    auto max_key = b.max_key ? b.max_key : cont.memStats().capacity / 100 * 99;
 
     auto generator = KeyGenerator::factory(b, b.generator, max_key);
 
+    if constexpr (!HasResize<Container>::value) {
+        if (b.resize_to) {
+            throw std::runtime_error(std::string(cont.name()) + " can't be resized");
+        }
+    }
+    bool resized = false;
+
+    if constexpr (!HasBulkLoad<Container>::value) {
+        if (b.prefill) {
+            throw std::runtime_error(std::string(cont.name()) + " has no bulk load");
+        }
+    }
+    // elements that fit into the cache and can be generated
+    size_t fill_count = std::min<size_t>(cont.memStats().capacity, max_key + 1);
+    if (b.prefill) {
+        prefillContainer(cont, fill_count, expected_payload, b.threads);
+    }
+
+    auto warmup = WarmupPhase::parse(b.warmup);
+    if (warmup.kind == WarmupPhase::Kind::Pass) {
+        throw std::runtime_error("Warm-up by a pass needs a trace");
+    }
+    size_t warmup_ops    = 0;
+    size_t warmup_misses = 0;
+    bool   warmup_over   = warmup.kind == WarmupPhase::Kind::None;
+
+    std::unique_ptr<TimeSeriesWriter>      series;
+    std::unique_ptr<RunSampler<Container>> sampler;
+    if (!b.series.empty()) {
+        series.reset(new TimeSeriesWriter(b.series, b.run_name, cont.name(), b.threads));
+        sampler.reset(new RunSampler<Container>(cont, b.threads, b.series_dt, *series));
+    }
+    std::unique_ptr<JsonLogger> json_logger;
+    if (!b.json_log.empty()) {
+        json_logger.reset(new JsonLogger(b.json_log));
+    }
+
     std::chrono::system_clock::time_point start;
 
     bool cancel_flag = false;
@@ -163,15 +633,98 @@ void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int ti
     size_t passed_iterations = 0;
     size_t total_hits        = 0;
 
+    ThreadPinning pinning;
+    pinning.policy    = ThreadPinning::parsePolicy(b.pin);
+    pinning.avoid_smt = b.avoid_smt;
+    pinning.cpu_list  = parseCpuList(b.pin_cpus);
+    if (pinning.policy == PinPolicy::List && pinning.cpu_list.empty()) {
+        throw std::runtime_error("--pin list requires --pin-cpus");
+    }
+    auto pin_plan = pinning.plan(b.threads);
+
+    PerfCounts hw_counters;
+
 #pragma omp parallel num_threads(b.threads) \
-    shared(generator, b, cont, start, cancel_flag, passed_iterations, total_hits)
+    shared(generator, b, cont, start, cancel_flag, passed_iterations, total_hits, pin_plan, \
+           hw_counters, warmup, warmup_ops, warmup_misses, warmup_over, sampler)
     {
+        if (!pin_plan.empty() && !pinCurrentThread(pin_plan[omp_get_thread_num()])) {
+            std::cerr << "Failed to pin thread " + std::to_string(omp_get_thread_num()) + "\n";
+        }
+
         auto private_gen = generator->clone();
         private_gen->setThread(omp_get_thread_num(), omp_get_num_threads());
+        PerfCounters thread_counters;
 
 #pragma omp single
         { start = std::chrono::system_clock::now(); };
 
+        // warm-up progress is shared in small steps, so a target is not overshot by much
+        const size_t check_freq   = std::clamp<size_t>(b.print_freq / 10, 1, 1024);
+        size_t       warm_iter    = 0;
+        size_t       warm_misses  = 0;
+        bool         private_over = warmup_over;
+        while (!private_over) {
+            KeySequence seq = private_gen->getKey();
+            for (lru_key_t key = seq.start_index; key < seq.start_index + seq.count; key++) {
+                lru_value_t value;
+                if (!cont.consumeCachedOrCompute(key, Payload(b.payload_level, key), value)) {
+                    warm_misses++;
+                }
+                if (++warm_iter % check_freq != 0) {
+                    continue;
+                }
+#pragma omp atomic update
+                warmup_ops += check_freq;
+#pragma omp atomic update
+                warmup_misses += warm_misses;
+                warm_misses = 0;
+
+                if (omp_get_thread_num() == 0) {
+                    size_t ops, misses;
+#pragma omp atomic read
+                    ops = warmup_ops;
+#pragma omp atomic read
+                    misses = warmup_misses;
+
+                    duration<double> dur = std::chrono::system_clock::now() - start;
+                    // a generator may never produce some keys
+                    if (warmup.isOver(ops, misses, dur.count(), fill_count) ||
+                        dur.count() > time_limit) {
+#pragma omp atomic write
+                        warmup_over = true;
+                    }
+                }
+#pragma omp atomic read
+                private_over = warmup_over;
+                if (private_over) {
+                    break;
+                }
+            }
+        }
+
+        if (warmup.kind != WarmupPhase::Kind::None) {
+            // the measured phase starts on a quiet cache
+#pragma omp barrier
+#pragma omp single
+            {
+                duration<double> dur = std::chrono::system_clock::now() - start;
+                std::cout << "Warm-up (" << warmup.describe() << ") took " << dur.count() * 1000
+                          << " ms, " << warmup_ops << " operations, " << warmup_misses
+                          << " misses" << std::endl;
+                cont.resetProfiler();
+                start = std::chrono::system_clock::now();
+            }
+        }
+        ThreadOpCounters* op_counters = nullptr;
+        if (sampler) {
+            op_counters = &sampler->counters(omp_get_thread_num());
+#pragma omp single
+            sampler->start();
+        }
+
+        thread_counters.start();
+
         size_t iter                = 0;
         size_t hits                = 0;
         bool   private_cancel_flag = false;
@@ -188,6 +741,9 @@ void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int ti
                 if (value != expected_value) {
                     std::cerr << "Wrong value: " << value << " != " << expected_value << std::endl;
                 }
+                if (op_counters && iter % ThreadOpCounters::kPublishEvery == 0) {
+                    op_counters->publish(iter, hits);
+                }
 
                 if (omp_get_thread_num() == 0 && iter % b.print_freq == 0) {
                     duration<double> dur = std::chrono::system_clock::now() - start;
@@ -197,6 +753,10 @@ void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int ti
                         cancel_flag         = true;
                         private_cancel_flag = true;
                     }
+                    if (b.resize_to && !resized && dur.count() > time_limit / 2.) {
+                        resizeContainer(cont, b.resize_to, b.is_item_capacity);
+                        resized = true;
+                    }
                 }
 
                 if (omp_get_thread_num() != 0 && iter % (b.print_freq / 10) == 0) {
@@ -206,6 +766,15 @@ void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int ti
             }
         }
 
+        thread_counters.stop();
+        auto thread_counts = thread_counters.read();
+        if (op_counters) {
+            op_counters->publish(iter, hits);
+        }
+
+#pragma omp critical
+        hw_counters += thread_counts;
+
 #pragma omp atomic update
         passed_iterations += iter;
 
@@ -215,30 +784,100 @@ void benchmark(RandomBenchmarkApp& b, Container& cont, CsvLogger& logger, int ti
 
     auto             stop = std::chrono::system_clock::now();
     duration<double> dur  = stop - start;
+    if (sampler) {
+        sampler->stop();
+    }
 
     logger.log(b.run_name, b.run_info, b.threads, b.payload_level, generator, cont,
                passed_iterations, total_hits, dur, b.pull_threshold, b.purge_threshold,
-               generator->getUniqueCount());
+               generator->getUniqueCount(), b.lock, b.promotion(), pinning.describe(b.threads),
+               hw_counters);
+    if constexpr (HasNumaAccessStats<Container>::value) {
+        auto stats = cont.accessStats();
+        std::cout << "Local/remote accesses:     " << stats.local << "/" << stats.remote << " ["
+                  << stats.localRatio() * 100 << "% local]" << std::endl;
+    }
+    printLockProfile(cont);
     // cont.memStats().print(std::cout);
+
+    if (json_logger) {
+        JsonObject results;
+        results.add("duration", dur.count())
+            .add("operations", passed_iterations)
+            .add("hits", total_hits)
+            .add("hit_rate", double(total_hits) / passed_iterations)
+            .add("throughput", passed_iterations / dur.count())
+            .add("thread_throughput", passed_iterations / dur.count() / b.threads)
+            .add("generator", generator->name())
+            .add("max_key", max_key)
+            .add("unique_keys", generator->getUniqueCount())
+            .add("promotion", b.promotion())
+            .add("topology", pinning.describe(b.threads));
+        if constexpr (HasNumaAccessStats<Container>::value) {
+            auto stats = cont.accessStats();
+            results.add("numa_local_accesses", stats.local)
+                .add("numa_remote_accesses", stats.remote);
+        }
+        json_logger->log("random", describeConfig(b), results, cont, lockProfileOf(cont),
+                         hw_counters, passed_iterations);
+    }
 }
 
 template <typename Container>
 void traceBenchmark(TraceBenchmarkApp& b, Container& cont, TraceCsvLogger& logger);
 
 TraceBenchmarkApp::TraceBenchmarkApp()
-    : app(help(), "Trace Benchmark"), iterations(1), capacity(0), pull_threshold(0.1),
-      purge_threshold(0.1), verbose(false) {
+    : app(help(), "Trace Benchmark"),
+      iterations(1),
+      capacity(0),
+      pull_threshold(0.1),
+      purge_threshold(0.1),
+      young_fraction(0),
+      recent_shards(1),
+      shards(0),
+      warmup("pass"),
+      series_dt(1),
+      verbose(false) {
     app.add_option("--log-file,-L", log_file)->required();
     app.add_option("--trace-file,-t", trace_file)->required();
     app.add_flag("--verbose,-v", verbose);
     app.add_set_ignore_case("--backend,-B", backend,
                             {"dummy", "hash", "lru", "concurrent", "deferred", "tbb", "tbb_hash",
-                             "hhvm", "b_lru", "b_concurrent", "b_deferred"})
+                             "hhvm", "b_lru", "b_concurrent", "b_deferred", "lru_swiss",
+                             "deferred_swiss", "concurrent_compact", "deferred_compact",
+                             "b_deferred_compact", "lru_soa", "deferred_soa", "numa_hash",
+                             "numa_replicated", "lru_fc", "lru_rb"})
         ->required();
     app.add_option("--capacity, -c", capacity);
     app.add_option("--iterations,-i", iterations);
     app.add_option("--pull-thrs", pull_threshold);
     app.add_option("--purge-thrs", purge_threshold);
+    app.add_option("--young-fraction", young_fraction,
+                   "ConcurrentLRU hits don't promote nodes in this youngest part of the list");
+    app.add_option("--promotion-probability", promotion_sampling.probability,
+                   "Share of hits that are promoted (LRU, concurrent and deferred backends)");
+    app.add_option("--promote-every", promotion_sampling.every_nth,
+                   "Promote only every Nth hit of a thread");
+    app.add_option("--recent-shards", recent_shards);
+    app.add_option("--shards", shards,
+                   "Shards of the b_* backends, 0 chooses them by thread count and capacity");
+    app.add_option("--snapshot", snapshot,
+                   "Warm up from this snapshot instead of the --warmup phase (lru and deferred"
+                   " backends), if it doesn't exist the cache is saved there after the warm-up");
+    app.add_option("--warmup", warmup,
+                   "Untimed phase before the passes: none, pass, <seconds>s, <operations> or "
+                   "full (as many misses as the cache holds)",
+                   true);
+    app.add_option("--series", series,
+                   "Append throughput, hit rate, evictions and memory of every --series-interval "
+                   "to this CSV (JSON lines if it ends in .jsonl)");
+    app.add_option("--series-interval", series_dt, "Seconds between --series samples", true);
+    app.add_option("--json-log", json_log,
+                   "Also append the run with its whole configuration to this JSON lines file");
+}
+
+std::string TraceBenchmarkApp::promotion() const {
+    return describePromotion(young_fraction, promotion_sampling);
 }
 
 const char* TraceBenchmarkApp::help() {
@@ -252,6 +891,7 @@ int TraceBenchmarkApp::parse(int argc, char** argv) {
     } catch (const CLI::ParseError& e) {
         return app.exit(e);
     };
+    return 0;
 }
 
 void TraceBenchmarkApp::run() {
@@ -261,6 +901,12 @@ void TraceBenchmarkApp::run() {
 
         TraceCsvLogger l(log_file, verbose);
 
+        // the trace is replayed by a single thread
+        ShardSizing::global().shards  = shards;
+        ShardSizing::global().threads = 1;
+
+        PromotionSampling::global() = promotion_sampling;
+
         volatile size_t tmp             = capacity;
         capacity                        = tmp;
         constexpr bool is_item_capacity = true;
@@ -275,10 +921,11 @@ void TraceBenchmarkApp::run() {
             LRUCache<config_t> lru(capacity, is_item_capacity);
             traceBenchmark(*this, lru, l);
         } else if (backend == "concurrent") {
-            ConcurrentLRU<config_t> lru(capacity, is_item_capacity);
+            ConcurrentLRU<config_t> lru(capacity, is_item_capacity, young_fraction);
             traceBenchmark(*this, lru, l);
         } else if (backend == "deferred") {
-            DeferredLRU<config_t> lru(capacity, is_item_capacity, pull_threshold, purge_threshold);
+            DeferredLRU<config_t> lru(capacity, is_item_capacity, pull_threshold, purge_threshold,
+                                      recent_shards);
             traceBenchmark(*this, lru, l);
         } else if (backend == "tbb") {
             TbbLRU<config_t> lru(capacity, is_item_capacity);
@@ -298,6 +945,48 @@ void TraceBenchmarkApp::run() {
         } else if (backend == "b_deferred") {
             BucketedDeferredLRU<config_t> lru(capacity, is_item_capacity);
             traceBenchmark(*this, lru, l);
+        } else if (backend == "lru_swiss") {
+            LRUCache<config_t, 0, true> lru(capacity, is_item_capacity);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "deferred_swiss") {
+            DeferredLRU<config_t, true> lru(capacity, is_item_capacity, pull_threshold,
+                                            purge_threshold, recent_shards);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "concurrent_compact") {
+            ConcurrentLRU<config_t, 0, uint32_t> lru(capacity, is_item_capacity, young_fraction);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "deferred_compact") {
+            DeferredLRU<config_t, false, uint32_t> lru(capacity, is_item_capacity, pull_threshold,
+                                                       purge_threshold, recent_shards);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "b_deferred_compact") {
+            BucketedCompactDeferredLRU<config_t> lru(capacity, is_item_capacity);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "lru_soa") {
+            LRUCache<config_t, 0, false, true> lru(capacity, is_item_capacity);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "deferred_soa") {
+            DeferredLRU<config_t, false, uint32_t, true> lru(
+                capacity, is_item_capacity, pull_threshold, purge_threshold, recent_shards);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "numa_hash") {
+            NumaDeferredLRU<config_t, NumaRouting::KeyHash> lru(capacity, is_item_capacity);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "numa_replicated") {
+            NumaDeferredLRU<config_t, NumaRouting::ReplicateHot> lru(capacity, is_item_capacity);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "lru_fc") {
+            LRUCache<config_t, 0, false, false, LruListSync::FlatCombining> lru(capacity,
+                                                                                is_item_capacity);
+            traceBenchmark(*this, lru, l);
+        } else if (backend == "lru_rb") {
+            // read buffers need a lock with a shared mode
+            using rb_config_t =
+                ContainerConfig<lru_key_t, lru_value_t, std::hash<lru_key_t>, std::less<>,
+                                BravoRWLock, EmptyDeletePolicy, 4, false, true>;
+            LRUCache<rb_config_t, 0, false, false, LruListSync::ReadBuffer> lru(capacity,
+                                                                                is_item_capacity);
+            traceBenchmark(*this, lru, l);
         } else {
             throw std::runtime_error("Unknown backend: " + backend);
         }
@@ -380,22 +1069,92 @@ void traceBenchmark(TraceBenchmarkApp& b, Container& cont, TraceCsvLogger& logge
 
     auto& trace = readTrace(b.trace_file);
 
+    bool warm_from_snapshot = false;
+    if (!b.snapshot.empty()) {
+        if constexpr (!HasSnapshot<Container>::value) {
+            throw std::runtime_error(std::string(cont.name()) + " has no snapshots");
+        }
+        warm_from_snapshot = std::ifstream(b.snapshot).good();
+    }
+
+    auto warmup = WarmupPhase::parse(b.warmup);
+
+    /// @return true on a hit
+    auto access = [&cont](lru_key_t key) {
+        lru_value_t value;
+        lru_value_t expected_value{{key, key / 2}};
+
+        bool hit =
+            cont.consumeCachedOrCompute(key, [=] { return lru_value_t{{key, key}}; }, value);
+        if (value != expected_value) {
+            std::cerr << "Wrong value: " << value << " != " << expected_value << std::endl;
+        }
+        return hit;
+    };
+
     std::chrono::system_clock::time_point start;
 
+    PerfCounters counters;
+
     start = std::chrono::system_clock::now();
-    for (size_t iter = 0; iter < b.iterations + 1; iter++) {
-        if (iter == 1) {
-            cont.resetProfiler();
+    if (warm_from_snapshot) {
+        // replaces the warm-up
+        loadSnapshot(cont, b.snapshot);
+    } else if (warmup.kind != WarmupPhase::Kind::None) {
+        size_t fill_count = std::min<size_t>(cont.memStats().capacity, trace.distinct_count);
+        size_t ops        = 0;
+        size_t misses     = 0;
+        bool   over       = false;
+        // the trace is replayed from the start as often as needed
+        for (size_t i = 0; !over && !trace.data.empty(); i = (i + 1) % trace.data.size()) {
+            for (size_t j = 0; j < trace.data[i].count; j++) {
+                misses += !access(trace.data[i].start_index + j);
+            }
+            ops += trace.data[i].count;
+
+            if (warmup.kind == WarmupPhase::Kind::Pass) {
+                over = i + 1 == trace.data.size();
+            } else {
+                duration<double> dur = std::chrono::system_clock::now() - start;
+                over = warmup.isOver(ops, misses, dur.count(), fill_count);
+            }
+        }
+
+        duration<double> warm = std::chrono::system_clock::now() - start;
+        std::cout << "Warm-up (" << warmup.describe() << ") took " << warm.count() * 1000
+                  << " ms, " << ops << " operations, " << misses << " misses" << std::endl;
+        if (!b.snapshot.empty()) {
+            saveSnapshot(cont, b.snapshot);
         }
+    }
+
+    std::unique_ptr<TimeSeriesWriter>      series;
+    std::unique_ptr<RunSampler<Container>> sampler;
+    ThreadOpCounters*                      op_counters = nullptr;
+    if (!b.series.empty()) {
+        series.reset(new TimeSeriesWriter(b.series, b.trace_file, cont.name(), 1));
+        sampler.reset(new RunSampler<Container>(cont, 1, b.series_dt, *series));
+        op_counters = &sampler->counters(0);
+    }
+    std::unique_ptr<JsonLogger> json_logger;
+    if (!b.json_log.empty()) {
+        json_logger.reset(new JsonLogger(b.json_log));
+    }
+
+    cont.resetProfiler();
+    counters.start();
+    start = std::chrono::system_clock::now();
+    if (sampler) {
+        sampler->start();
+    }
+    size_t ops  = 0;
+    size_t hits = 0;
+    for (size_t iter = 1; iter < b.iterations + 1; iter++) {
         for (size_t i = 0; i < trace.data.size(); i++) {
             for (size_t j = 0; j < trace.data[i].count; j++) {
-                lru_key_t   key = trace.data[i].start_index + j;
-                lru_value_t value;
-                lru_value_t expected_value{{key, key / 2}};
-
-                cont.consumeCachedOrCompute(key, [=] { return lru_value_t{{key, key}}; }, value);
-                if (value != expected_value) {
-                    std::cerr << "Wrong value: " << value << " != " << expected_value << std::endl;
+                hits += access(trace.data[i].start_index + j);
+                if (++ops % ThreadOpCounters::kPublishEvery == 0 && op_counters) {
+                    op_counters->publish(ops, hits);
                 }
 
                 if (i % 1000000 == 0) {
@@ -407,9 +1166,31 @@ void traceBenchmark(TraceBenchmarkApp& b, Container& cont, TraceCsvLogger& logge
 
     auto             stop = std::chrono::system_clock::now();
     duration<double> dur  = stop - start;
+    counters.stop();
+    if (sampler) {
+        op_counters->publish(ops, hits);
+        sampler->stop();
+    }
 
+    PerfCounts hw_counters;
+    hw_counters += counters.read();
     logger.log("", b.trace_file, cont, trace.distinct_count, b.iterations, dur, b.pull_threshold,
-               b.purge_threshold);
+               b.purge_threshold, b.promotion(), hw_counters);
+    printLockProfile(cont);
+
+    if (json_logger) {
+        JsonObject results;
+        results.add("duration", dur.count())
+            .add("passes", b.iterations)
+            .add("operations", ops)
+            .add("hits", hits)
+            .add("hit_rate", double(hits) / ops)
+            .add("throughput", ops / dur.count())
+            .add("trace_items", trace.distinct_count)
+            .add("promotion", b.promotion());
+        json_logger->log("trace", describeConfig(b), results, cont, lockProfileOf(cont),
+                         hw_counters, ops);
+    }
 }
 
 #pragma clang diagnostic pop
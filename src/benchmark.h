@@ -3,6 +3,7 @@
 #include <string>
 
 #include "CLI11.hpp"
+#include "containers/promotion.h"
 
 struct KeySequence {
     uint64_t start_index;
@@ -17,24 +18,61 @@ struct Trace {
 
 const Trace& readTrace(const std::string& path);
 
+/**
+ * Warm-up phase before the measured one, its operations are neither timed nor counted.
+ * Parsed from "none", "pass" (one pass over a trace), "<seconds>s", "<n>" operations
+ * or "full", which runs until there were as many misses as the cache can hold.
+ */
+struct WarmupPhase {
+    enum class Kind { None, Pass, Time, Ops, Full };
+
+    Kind   kind    = Kind::None;
+    double seconds = 0;
+    size_t ops     = 0;
+
+    static WarmupPhase parse(const std::string& s);
+
+    /// @param fill_count misses that make the cache full
+    bool isOver(size_t done_ops, size_t misses, double elapsed, size_t fill_count) const;
+
+    std::string describe() const;
+};
+
 struct RandomBenchmarkApp {
-    CLI::App    app;
-    std::string log_file;
-    std::string run_name;
-    std::string run_info;
-    std::string generator;
-    std::string backend;
-    int         payload_level;
-    unsigned    threads;
-    bool        limit_max_key;
-    bool        is_item_capacity;
-    size_t      capacity;
-    double      pull_threshold;
-    double      purge_threshold;
-    bool        verbose;
-    bool        profile;
-    size_t      print_freq;
-    int         time_limit;
+    CLI::App          app;
+    std::string       log_file;
+    std::string       run_name;
+    std::string       run_info;
+    std::string       generator;
+    std::string       backend;
+    int               payload_level;
+    unsigned          threads;
+    bool              limit_max_key;
+    size_t            max_key; ///< 0 is 99% of the capacity
+    bool              is_item_capacity;
+    size_t            capacity;
+    double            pull_threshold;
+    double            purge_threshold;
+    double            young_fraction;
+    PromotionSampling promotion_sampling;
+    size_t            recent_shards;
+    size_t            shards;    ///< BucketedAdapter shards, 0 chooses them by threads and capacity
+    size_t            resize_to; ///< capacity set halfway through the run, 0 keeps it
+    bool              prefill;   ///< bulk load the cache before the run
+    std::string       warmup;    ///< WarmupPhase spec
+    std::string       series;    ///< time series file of the run, see TimeSeriesWriter
+    double            series_dt; ///< seconds between time series samples
+    std::string       json_log;  ///< JSON lines results, see JsonLogger
+    bool              verbose;
+    bool              profile;
+    size_t            print_freq;
+    int               time_limit;
+    std::string       pages;
+    std::string       numa;
+    std::string       pin;
+    std::string       pin_cpus;
+    bool              avoid_smt;
+    std::string       lock;
 
     RandomBenchmarkApp();
 
@@ -44,21 +82,35 @@ struct RandomBenchmarkApp {
 
     void run();
 
+    std::string promotion() const;
+
   private:
     template <bool EnableProfile>
+    void runWithLock();
+
+    template <bool EnableProfile, typename LockT>
     void runImpl();
 };
 
 struct TraceBenchmarkApp {
-    CLI::App    app;
-    std::string log_file;
-    std::string trace_file;
-    std::string backend;
-    size_t      iterations;
-    size_t      capacity;
-    double      pull_threshold;
-    double      purge_threshold;
-    bool        verbose;
+    CLI::App          app;
+    std::string       log_file;
+    std::string       trace_file;
+    std::string       backend;
+    size_t            iterations;
+    size_t            capacity;
+    double            pull_threshold;
+    double            purge_threshold;
+    double            young_fraction;
+    PromotionSampling promotion_sampling;
+    size_t            recent_shards;
+    size_t            shards;    ///< BucketedAdapter shards, 0 chooses them by threads and capacity
+    std::string       snapshot;  ///< warm-up snapshot, written after the warm-up if missing
+    std::string       warmup;    ///< WarmupPhase spec
+    std::string       series;    ///< time series file of the passes, see TimeSeriesWriter
+    double            series_dt; ///< seconds between time series samples
+    std::string       json_log;  ///< JSON lines results, see JsonLogger
+    bool              verbose;
 
     TraceBenchmarkApp();
 
@@ -67,4 +119,6 @@ struct TraceBenchmarkApp {
     int parse(int argc, char** argv);
 
     void run();
+
+    std::string promotion() const;
 };
@@ -1,17 +1,42 @@
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <mutex>
 #include <thread>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 
-void increment_mutex(int thread_count, size_t count) {
-    std::mutex lock;
-    size_t var = 0;
+#include "locks.h"
+#include "utility.h"
+
+/// Shared data modified in the critical section, each counter on its own cache line
+struct CACHELINE_ALIGN SharedCounter {
+    size_t value = 0;
+};
+
+void print_result(const char* name, int thread_count, size_t count,
+                  std::chrono::duration<float> dur, size_t value) {
+    size_t total = count * thread_count;
+    std::cout << name << ": made " << total << " increments with " << thread_count << " threads in "
+              << dur.count() << "s (" << dur.count() * 1e9 / total << " ns/op)\n";
+    if (value != total) {
+        std::cout << "Actual variable value: " << value << " (expected " << total << ")"
+                  << std::endl;
+    }
+}
+
+/**
+ * Increments `lines` counters under LockT, the critical section is about as long
+ * as a bucket or list update of a container for a few lines.
+ */
+template <typename LockT>
+void increment_lock(const char* name, int thread_count, size_t count, size_t lines) {
+    LockT lock;
+    std::vector<SharedCounter> vars(lines);
     std::chrono::high_resolution_clock::time_point start, stop;
 
-    #pragma omp parallel shared(lock, var, start, stop, count) num_threads(thread_count)
+    #pragma omp parallel shared(lock, vars, start, stop, count) num_threads(thread_count)
     {
         #pragma omp barrier
         #pragma omp master
@@ -20,8 +45,10 @@ void increment_mutex(int thread_count, size_t count) {
         }
 
         for (size_t i = 0; i < count; i++) {
-            std::lock_guard guard{lock};
-            var++;
+            std::lock_guard<LockT> guard{lock};
+            for (auto& var : vars) {
+                var.value++;
+            }
         }
 
         #pragma omp barrier
@@ -31,9 +58,7 @@ void increment_mutex(int thread_count, size_t count) {
         }
     }
 
-    std::chrono::duration<float> dur = stop - start;
-    std::cout << "Mutex: made " << (size_t)count * thread_count << " increments in " << dur.count() << "s\n";
-    std::cout << "Actual variable value: " << var << std::endl;
+    print_result(name, thread_count, count, stop - start, vars[0].value);
 }
 
 void increment_atomic(int thread_count, size_t count) {
@@ -58,9 +83,7 @@ void increment_atomic(int thread_count, size_t count) {
             stop = std::chrono::high_resolution_clock::now();
         }
     }
-    std::chrono::duration<float> dur = stop - start;
-    std::cout << "AtomicINC: made " << (size_t)count * thread_count << " increments in " << dur.count() << "s\n";
-    std::cout << "Actual variable value: " << var.load() << std::endl;
+    print_result("AtomicINC", thread_count, count, stop - start, var.load());
 }
 
 void increment_atomic_cas(int thread_count, size_t count) {
@@ -87,16 +110,26 @@ void increment_atomic_cas(int thread_count, size_t count) {
             stop = std::chrono::high_resolution_clock::now();
         }
     }
-    std::chrono::duration<float> dur = stop - start;
-    std::cout << "AtomicCAS: made " << (size_t)count * thread_count << " increments in " << dur.count() << "s\n";
-    std::cout << "Actual variable value: " << var.load() << std::endl;
+    print_result("AtomicCAS", thread_count, count, stop - start, var.load());
 }
 
 
-int main() {
-    int threads = 32;
-    size_t count = 100000000;
-    increment_mutex(threads, count);
-    increment_atomic(threads, count);
-    increment_atomic_cas(threads, count);
+/// usage: increment_test [max threads] [increments per thread] [cache lines per critical section]
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : 32;
+    size_t count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    size_t lines = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        increment_lock<std::mutex>("Mutex", threads, count, lines);
+        increment_lock<OpenMPLock>("OpenMP", threads, count, lines);
+        increment_lock<TTASLock>("TTAS", threads, count, lines);
+        increment_lock<ByteLock>("Byte", threads, count, lines);
+        increment_lock<TicketLock>("Ticket", threads, count, lines);
+        increment_lock<MCSLock>("MCS", threads, count, lines);
+        increment_lock<FutexLock>("Futex", threads, count, lines);
+        increment_atomic(threads, count);
+        increment_atomic_cas(threads, count);
+        std::cout << std::endl;
+    }
 }
@@ -1,12 +1,71 @@
 #pragma once
 
+#include <omp.h>
+
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "containers/concurrent_lru.h"
 #include "containers/deferred_lru.h"
 #include "containers/lru.h"
 
-template <typename Config, typename ContainerT, unsigned LogBucketCount>
+/**
+ * # ShardSizing
+ * Number of BucketedAdapter shards, chosen when the adapter allocates its memory.
+ *
+ * By default a few shards per thread keep lock contention low,
+ * but a shard never gets fewer than min_shard_items elements,
+ * so small caches don't end up with shards too small for their hash tables.
+ * Like NodePlacement it is a process-wide setting
+ * that the benchmark selects before constructing a container.
+ */
+struct ShardSizing {
+    size_t   shards            = 0;    ///< fixed count, rounded up to a power of two, 0 is auto
+    unsigned threads           = 0;    ///< threads using the container, 0 is omp_get_max_threads()
+    unsigned shards_per_thread = 4;    ///< auto shard count per thread
+    size_t   min_shard_items   = 1024; ///< auto shard count never makes shards smaller
+
+    static ShardSizing& global() {
+        static ShardSizing sizing;
+        return sizing;
+    }
+
+    /// Log2 of the shard count for a container of item_capacity elements
+    unsigned logShardCount(size_t item_capacity, size_t max_shard_items) const {
+        size_t count = shards;
+        if (count == 0) {
+            size_t thread_count = threads ? threads : size_t(omp_get_max_threads());
+            count = roundUpToPowerOfTwo(thread_count * std::max(shards_per_thread, 1u));
+            while (count > 1 && item_capacity / count < min_shard_items) {
+                count /= 2;
+            }
+        }
+        count = roundUpToPowerOfTwo(std::max<size_t>(count, 1));
+        while ((item_capacity + count - 1) / count > max_shard_items) {
+            count *= 2;
+        }
+
+        unsigned log = 0;
+        while ((size_t(1) << log) < count) {
+            log++;
+        }
+        return log;
+    }
+};
+
+/**
+ * # BucketedAdapter
+ * Shards a container by the high bits of the key hash.
+ *
+ * The shard count is a power of two chosen at runtime by ShardSizing,
+ * shards that must stay small (e.g. with 16-bit node indices)
+ * get at most MaxShardItems elements each.
+ */
+template <typename Config, typename ContainerT,
+          size_t MaxShardItems = std::numeric_limits<size_t>::max()>
 class BucketedAdapter {
     using key_t   = typename Config::key_t;
     using value_t = typename Config::value_t;
@@ -18,16 +77,54 @@ class BucketedAdapter {
         allocateMemory(capacity, is_item_capacity);
     }
 
-    static constexpr size_t bucketCount() { return 1u << LogBucketCount; }
+    size_t bucketCount() const { return size_t(1) << log_bucket_count_; }
 
     void allocateMemory(size_t capacity, bool is_item_capacity) {
+        size_t item_capacity =
+            is_item_capacity ? capacity : size_t(capacity / ContainerT::elementSize());
+        unsigned log_bucket_count =
+            ShardSizing::global().logShardCount(item_capacity, MaxShardItems);
+        if (log_bucket_count != log_bucket_count_) {
+            log_bucket_count_ = log_bucket_count;
+            containers_.reset(new ContainerT[bucketCount()]);
+        }
+
+        for (size_t i = 0; i < bucketCount(); i++) {
+            containers_[i].allocateMemory(evenShare(capacity, bucketCount(), i), is_item_capacity);
+        }
+    }
+
+    /// Resizes every shard to its share of the capacity, only if the containers have resize()
+    template <typename C = ContainerT>
+    auto resize(size_t capacity, bool is_item_capacity = true)
+        -> decltype(std::declval<C&>().resize(capacity, is_item_capacity)) {
         for (size_t i = 0; i < bucketCount(); i++) {
-            containers_[i].allocateMemory(capacity / bucketCount() +
-                                              (i == 0 ? capacity % bucketCount() : 0),
-                                          is_item_capacity);
+            containers_[i].resize(evenShare(capacity, bucketCount(), i), is_item_capacity);
         }
     }
 
+    /**
+     * Bulk loads key/value pairs (first, second), only if the containers have bulkLoad().
+     * Pairs are grouped by shard and the shards are loaded in parallel, one thread each.
+     * @return number of inserted elements
+     */
+    template <typename RandomIt, typename C = ContainerT>
+    auto bulkLoad(RandomIt first, RandomIt last, unsigned threads = 0)
+        -> decltype(std::declval<C&>().bulkLoad(first, last, threads)) {
+        std::vector<std::vector<std::pair<key_t, value_t>>> shard_pairs(bucketCount());
+        for (RandomIt it = first; it != last; ++it) {
+            shard_pairs[getBucketNr(it->first)].emplace_back(it->first, it->second);
+        }
+
+        size_t loaded = 0;
+#pragma omp parallel for num_threads(threads ? threads : omp_get_max_threads()) \
+    schedule(dynamic) reduction(+ : loaded)
+        for (size_t i = 0; i < bucketCount(); i++) {
+            loaded += containers_[i].bulkLoad(shard_pairs[i].begin(), shard_pairs[i].end(), 1);
+        }
+        return loaded;
+    }
+
     /// calls the policy on all the objects in the cache
     void releaseMemory() {
         for (size_t i = 0; i < bucketCount(); i++) {
@@ -47,19 +144,30 @@ class BucketedAdapter {
         return res;
     }
 
+    /// Lock profiles of all shards, hot buckets are reported with their shard number
+    LockProfileReport lockProfile() const {
+        LockProfileReport res;
+        for (size_t i = 0; i < bucketCount(); i++) {
+            res.merge(containers_[i].lockProfile(), i);
+        }
+        return res;
+    }
+
     template <typename Producer, typename Consumer>
     bool consumeCachedOrCompute(const key_t& key, const Producer& producer, Consumer& consumer) {
         size_t bucket_nr = getBucketNr(key);
         return containers_[bucket_nr].consumeCachedOrCompute(key, producer, consumer);
     }
 
-    size_t getBucketNr(size_t x) {
-        x = (x ^ (x >> 30u)) * UINT64_C(0xbf58476d1ce4e5b9);
-        x = (x ^ (x >> 27u)) * UINT64_C(0x94d049bb133111eb);
-        x = x ^ (x >> 31u);
-
-        constexpr size_t mask = bucketCount() - 1;
-        return x & mask;
+    /**
+     * Containers index their tables with the low bits of the mixed hash,
+     * so the shard is chosen by the high bits to keep them independent.
+     */
+    size_t getBucketNr(const key_t& key) {
+        if (log_bucket_count_ == 0) {
+            return 0;
+        }
+        return mixHash(hasher_(key)) >> (sizeof(size_t) * 8 - log_bucket_count_);
     }
 
     MemStats memStats() const {
@@ -87,21 +195,29 @@ class BucketedAdapter {
     }
 
   private:
+    unsigned                      log_bucket_count_ = 0;
     typename Config::hasher_t     hasher_;
     std::unique_ptr<ContainerT[]> containers_;
 };
 
 template <typename Config>
-class BucketedLRU : public BucketedAdapter<Config, LRUCache<Config>, 6> {
-    using BucketedAdapter<Config, LRUCache<Config>, 6>::BucketedAdapter;
+class BucketedLRU : public BucketedAdapter<Config, LRUCache<Config>> {
+    using BucketedAdapter<Config, LRUCache<Config>>::BucketedAdapter;
+};
+
+template <typename Config>
+class BucketedDeferredLRU : public BucketedAdapter<Config, DeferredLRU<Config>> {
+    using BucketedAdapter<Config, DeferredLRU<Config>>::BucketedAdapter;
 };
 
 template <typename Config>
-class BucketedDeferredLRU : public BucketedAdapter<Config, DeferredLRU<Config>, 6> {
-    using BucketedAdapter<Config, DeferredLRU<Config>, 6>::BucketedAdapter;
+class BucketedConcurrentLRU : public BucketedAdapter<Config, ConcurrentLRU<Config>> {
+    using BucketedAdapter<Config, ConcurrentLRU<Config>>::BucketedAdapter;
 };
 
+/// Shards are small enough for 16-bit node indices, see DeferredLRU
 template <typename Config>
-class BucketedConcurrentLRU : public BucketedAdapter<Config, ConcurrentLRU<Config>, 6> {
-    using BucketedAdapter<Config, ConcurrentLRU<Config>, 6>::BucketedAdapter;
+class BucketedCompactDeferredLRU
+    : public BucketedAdapter<Config, DeferredLRU<Config, false, uint16_t>, 16384> {
+    using BucketedAdapter<Config, DeferredLRU<Config, false, uint16_t>, 16384>::BucketedAdapter;
 };
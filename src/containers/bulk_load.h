@@ -0,0 +1,82 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * # BulkLoadPartition
+ * Groups the records of a bulk load by the thread that owns their bucket.
+ *
+ * Buckets are split into contiguous ranges, one per thread,
+ * so each thread links the records of its own buckets and takes no bucket lock.
+ * Records are partitioned in two parallel passes (count, then scatter)
+ * and keep their relative order within a range.
+ */
+class BulkLoadPartition {
+  public:
+    /**
+     * @param count number of records
+     * @param bucket_count buckets are numbered [0, bucket_count)
+     * @param threads number of bucket ranges and of threads partitioning the records
+     * @param bucket_of bucket_of(i) is the bucket of record i, called once per record
+     */
+    template <typename BucketOf>
+    BulkLoadPartition(size_t count, size_t bucket_count, unsigned threads,
+                      const BucketOf& bucket_of)
+        : threads_(std::max(threads, 1u)), bucket_count_(std::max<size_t>(bucket_count, 1)),
+          order_(count), begin_(threads_ + 1) {
+        std::vector<uint32_t> owners(count);
+        // counts of [slice][owner], turned into scatter positions
+        std::vector<size_t> positions(size_t(threads_) * threads_);
+
+#pragma omp parallel for num_threads(threads_) schedule(static, 1)
+        for (unsigned t = 0; t < threads_; t++) {
+            size_t* counts = &positions[size_t(t) * threads_];
+            for (size_t i = sliceBegin(count, t); i < sliceBegin(count, t + 1); i++) {
+                owners[i] = ownerOf(bucket_of(i));
+                counts[owners[i]]++;
+            }
+        }
+
+        size_t pos = 0;
+        for (unsigned owner = 0; owner < threads_; owner++) {
+            begin_[owner] = pos;
+            for (unsigned t = 0; t < threads_; t++) {
+                size_t& slot = positions[size_t(t) * threads_ + owner];
+                size_t  n    = slot;
+                slot         = pos;
+                pos += n;
+            }
+        }
+        begin_[threads_] = pos;
+
+#pragma omp parallel for num_threads(threads_) schedule(static, 1)
+        for (unsigned t = 0; t < threads_; t++) {
+            size_t* next = &positions[size_t(t) * threads_];
+            for (size_t i = sliceBegin(count, t); i < sliceBegin(count, t + 1); i++) {
+                order_[next[owners[i]]++] = i;
+            }
+        }
+    }
+
+    unsigned threads() const { return threads_; }
+
+    /// Records of the buckets owned by thread t
+    const size_t* begin(unsigned t) const { return order_.data() + begin_[t]; }
+
+    const size_t* end(unsigned t) const { return order_.data() + begin_[t + 1]; }
+
+  private:
+    size_t sliceBegin(size_t count, unsigned t) const { return count * t / threads_; }
+
+    uint32_t ownerOf(size_t bucket) const { return uint32_t(bucket * threads_ / bucket_count_); }
+
+    unsigned            threads_;
+    size_t              bucket_count_;
+    std::vector<size_t> order_; ///< record numbers grouped by owner
+    std::vector<size_t> begin_; ///< start of each owner in order_
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <csignal>
+#include <cstdint>
 #include <mutex>
 #include <set>
 #include <vector>
@@ -11,8 +13,11 @@
 
 #include <folly/PackedSyncPtr.h>
 
+#include "containers/bulk_load.h"
 #include "containers/container_base.h"
 #include "containers/lru.h"
+#include "containers/node_array.h"
+#include "containers/node_links.h"
 #include "utility.h"
 
 #define TRACE_LOCKS 0
@@ -20,8 +25,20 @@
 #define DISABLE_LOCKS 0
 #define HT_EXTERNAL_LOCK 1
 
-template <typename Config, unsigned int IgnoreBitsInHash = 0>
-class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreBitsInHash>, false> {
+/**
+ * With NodeIndexT = uint32_t or uint16_t LRU/pool lists are linked
+ * with indices into the node array instead of pointers (see NodeLinks),
+ * list sentinels are kept at the end of the node array.
+ *
+ * A hit moves the node to the LRU tail, which locks the node, its neighbours
+ * and the tail sentinel, so hits on hot keys serialize on the tail.
+ * With young_fraction > 0 a hit skips the move if the node was appended
+ * to the tail less than young_fraction * capacity appends ago,
+ * i.e. if it is still among the youngest nodes of the list.
+ */
+template <typename Config, unsigned int IgnoreBitsInHash = 0, typename NodeIndexT = void>
+class ConcurrentLRU
+    : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>, false> {
     using config  = Config;
     using key_t   = typename config::key_t;
     using value_t = typename config::value_t;
@@ -30,6 +47,10 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
     using backoff_t  = folly::detail::Sleeper;
     using lock_t     = typename config::locking_t;
 
+    class Node;
+    using links_t = NodeLinks<Node, Node, NodeIndexT>;
+    using link_t  = typename links_t::link_t;
+
     class NodeBase {
         sync_ptr_t<NodeBase> sync_ptr_;
 
@@ -83,36 +104,43 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
 
     class Node : public NodeBase {
       public:
-        Node() : lru_next(nullptr), lru_prev(nullptr), key(), value() {}
+        Node() : lru_next(links_t::null()), lru_prev(links_t::null()), key(), value() {}
 
         bool dataIsValidForKey(const key_t& target_key) {
             return this->lruFlag() && target_key == key;
         }
 
-        Node* lru_next;
-        Node* lru_prev;
+        link_t   lru_next;
+        link_t   lru_prev;
+        uint32_t lru_stamp = 0; ///< lru_clock_ when the node was appended to the tail
 
         key_t   key;
         value_t value;
     };
 
   public:
-    explicit ConcurrentLRU(size_t capacity = 0, bool is_item_capacity = false) {
+    explicit ConcurrentLRU(size_t capacity = 0, bool is_item_capacity = false,
+                           double young_fraction = 0)
+        : young_fraction_(young_fraction) {
         allocateMemory(capacity, is_item_capacity);
 #if TRACE_LOCKS
-        std::cout << "pool_head: " << &pool_head_ << "\n";
-        std::cout << "pool_tail: " << &pool_tail_ << "\n";
-        std::cout << "lru_head:  " << &lru_head_ << "\n";
-        std::cout << "lru_tail:  " << &lru_tail_ << "\n";
+        std::cout << "pool_head: " << poolHead() << "\n";
+        std::cout << "pool_tail: " << poolTail() << "\n";
+        std::cout << "lru_head:  " << lruHead() << "\n";
+        std::cout << "lru_tail:  " << lruTail() << "\n";
 #endif
     }
 
     ~ConcurrentLRU() { releaseMemory(); }
 
-    static const char* name() { return "ConcurrentLRU"; }
+    static const char* name() {
+        return links_t::is_index ? "ConcurrentLRU_Compact" : "ConcurrentLRU";
+    }
 
     decltype(auto) profileStats() const { return profile_stats_.getSlice(); }
 
+    LockProfileReport lockProfile() const { return lock_profiler_.report(); }
+
     size_t memoryUsage() const { return this->capacity(); }
 
     size_t currentOverheadMemory() const {
@@ -129,39 +157,45 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         if (capacity == 0) {
             return;
         }
-        
-        ht_.assign(size_t((this->max_element_count_ + config::hashTableLoadFactor() - 1) /
-                          config::hashTableLoadFactor()),
-                   NodeBase());
+        if (this->max_element_count_ + sentinelNodeCount() > links_t::maxNodeCount()) {
+            throw std::runtime_error("Too large capacity");
+        }
+
+        ht_.allocate(
+            bucketCountForLoadFactor(this->max_element_count_, config::hashTableLoadFactor()));
         if (ht_.size() < 4) {
             throw std::runtime_error("Too small capacity");
         }
-        ht_locks_.reset(new lock_t[ht_.size()]);
-        data_.resize(this->max_element_count_);
+        ht_mask_ = ht_.size() - 1;
+        ht_locks_.allocate(ht_.size());
+        young_count_ = uint32_t(young_fraction_ * this->max_element_count_);
+        lock_profiler_.trackBuckets(ht_.size());
+        data_.allocate(this->max_element_count_ + sentinelNodeCount());
+        links_.reset(data_.get());
 
 #if TRACE_LOCKS
-        std::cout << "data:      " << data_.data() << "\n           " << data_.data() + data_.size()
+        std::cout << "data:      " << data_.get() << "\n           " << data_.get() + data_.size()
                   << "\n";
         std::cout << "size:      " << data_.size() << std::endl;
 #endif
 
         // init "empty" linked list
-        lru_head_.lru_next = &lru_tail_;
-        lru_tail_.lru_prev = &lru_head_;
-        lru_head_.lruSetFlag(true);
-        lru_head_.htSetFlag(true);
-        lru_tail_.lruSetFlag(true);
-        lru_tail_.htSetFlag(true);
-
-        auto prev = &pool_head_;
-        for (auto& node : data_) {
-            prev->lru_next = &node;
-            node.lru_prev  = prev;
-            prev           = &node;
+        lruHead()->lru_next = link(lruTail());
+        lruTail()->lru_prev = link(lruHead());
+        lruHead()->lruSetFlag(true);
+        lruHead()->htSetFlag(true);
+        lruTail()->lruSetFlag(true);
+        lruTail()->htSetFlag(true);
+
+        Node* prev = poolHead();
+        for (size_t i = 0; i < this->max_element_count_; i++) {
+            prev->lru_next    = link(&data_[i]);
+            data_[i].lru_prev = link(prev);
+            prev              = &data_[i];
         }
 
-        data_.back().lru_next = &pool_tail_;
-        pool_tail_.lru_prev   = &data_.back();
+        prev->lru_next       = link(poolTail());
+        poolTail()->lru_prev = link(prev);
 
         profile_stats_.reset();
     }
@@ -175,10 +209,9 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
                 node = reinterpret_cast<Node*>(node->htNext());
             }
         }
-        data_.clear();
-        data_.shrink_to_fit();
-        ht_.clear();
-        ht_.shrink_to_fit();
+        data_.reset();
+        links_.reset(nullptr);
+        ht_.reset();
         ht_locks_.reset();
     }
 
@@ -214,6 +247,80 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         return true;
     }
 
+    /**
+     * Inserts key/value pairs (first, second) into an empty or quiesced cache,
+     * no other thread may use the cache meanwhile.
+     * Nodes are detached from the pool at once and linked into the table
+     * and the LRU list directly, without node or bucket locks:
+     * bucket ranges are built by different threads (see BulkLoadPartition).
+     * The range goes from the most to the least recently used pair
+     * and becomes more recent than the nodes already in the cache.
+     * Pairs that don't fit into the pool and keys that are already present are skipped.
+     *
+     * @param threads 0 is omp_get_max_threads()
+     * @return number of inserted nodes
+     */
+    template <typename RandomIt>
+    size_t bulkLoad(RandomIt first, RandomIt last, unsigned threads = 0) {
+        threads = threads ? threads : unsigned(omp_get_max_threads());
+
+        std::vector<Node*> nodes;
+        nodes.reserve(std::min(size_t(last - first), this->max_element_count_));
+        Node* pool_next = ptr(poolHead()->lru_next);
+        while (nodes.size() < size_t(last - first) && pool_next != poolTail()) {
+            nodes.push_back(pool_next);
+            pool_next = ptr(pool_next->lru_next);
+        }
+        poolHead()->lru_next = link(pool_next);
+        pool_next->lru_prev  = link(poolHead());
+
+        std::vector<size_t> buckets(nodes.size());
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (size_t i = 0; i < nodes.size(); i++) {
+            nodes[i]->key   = first[i].first;
+            nodes[i]->value = first[i].second;
+            buckets[i]      = whichBucket(nodes[i]->key);
+        }
+
+        std::vector<uint8_t> inserted(nodes.size());
+        BulkLoadPartition    partition(nodes.size(), ht_.size(), threads,
+                                       [&](size_t i) { return buckets[i]; });
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+        for (unsigned t = 0; t < partition.threads(); t++) {
+            for (const size_t* i = partition.begin(t); i != partition.end(t); i++) {
+                inserted[*i] = htInsertUnlocked(nodes[*i], buckets[*i]);
+            }
+        }
+
+        size_t loaded = 0;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (inserted[i]) {
+                nodes[loaded++] = nodes[i];
+            } else {
+                deleter_.onDelete(std::move(nodes[i]->key), std::move(nodes[i]->value));
+                putNodeToPool(nodes[i]);
+            }
+        }
+        if (loaded == 0) {
+            return 0;
+        }
+
+        // the first pair is the most recent one, next to the LRU tail
+        Node*    old_last = ptr(lruTail()->lru_prev);
+        uint32_t stamp    = young_count_ ? lru_clock_.fetch_add(uint32_t(loaded)) : 0;
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (size_t i = 0; i < loaded; i++) {
+            nodes[i]->lru_next  = link(i ? nodes[i - 1] : lruTail());
+            nodes[i]->lru_prev  = link(i + 1 < loaded ? nodes[i + 1] : old_last);
+            nodes[i]->lru_stamp = stamp + uint32_t(loaded - 1 - i);
+            nodes[i]->lruSetFlag(true);
+        }
+        old_last->lru_next  = link(nodes[loaded - 1]);
+        lruTail()->lru_prev = link(nodes[0]);
+        this->current_element_count_ += loaded;
+        return loaded;
+    }
+
     template <typename Consumer>
     bool find(const key_t& key, Consumer& consumer) {
         profile_stats_.find++;
@@ -226,7 +333,9 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         _lockNode(node, "api.find");
         if (node->dataIsValidForKey(key)) {
             consumer = node->value;
-            lruMoveToTail(node);
+            if (!isYoung(node) && promotion_sampler_.promote()) {
+                lruMoveToTail(node);
+            }
             _unlockNode(node, "api.find:ok");
             return true;
         } else {
@@ -251,7 +360,10 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
 
     void dump();
 
-    void resetProfiler() { profile_stats_.reset(); }
+    void resetProfiler() {
+        profile_stats_.reset();
+        lock_profiler_.reset();
+    }
 
   private:
     static size_t memSizeForElements(size_t count) {
@@ -274,7 +386,7 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         std::cerr << buf;
 #endif
 
-        node->lock();
+        lock_profiler_.lock(LockClass::Node, *node);
 
 #if TRACE_LOCKS
         sprintf(buf, "%d: +%s[%s]\n", omp_get_thread_num(), reason, name);
@@ -294,7 +406,7 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
     }
 
     bool _tryLockNode(Node* node, const char* reason) {
-        bool success = node->try_lock();
+        bool success = lock_profiler_.tryLock(LockClass::Node, *node);
 
 #if TRACE_LOCKS
         char name[100], buf[100];
@@ -331,22 +443,22 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
      */
     Node* listEvictNext(Node* prev, Node* last_node) {
         _lockNode(prev, "evict.prev");
-        Node* node = prev->lru_next;
+        Node* node = ptr(prev->lru_next);
         if (node == last_node) {
             _unlockNode(prev, "evict.prev:empty");
             return nullptr;
         }
         _lockNode(node, "evict.node");
-        Node* next = node->lru_next;
+        Node* next = ptr(node->lru_next);
 
         _lockNode(next, "evict.next");
 
-        prev->lru_next = next;
-        next->lru_prev = prev;
+        prev->lru_next = link(next);
+        next->lru_prev = link(prev);
         _unlockNode(prev, "evict.prev");
         _unlockNode(next, "evict.next");
 
-        node->lru_next = node->lru_prev = nullptr;
+        node->lru_next = node->lru_prev = links_t::null();
         return node;
     }
 
@@ -362,33 +474,34 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
      */
     void listInsertBefore(Node* node, Node* new_prev) {
         while (true) {
-            Node* prev = node->lru_prev;
+            Node* prev = ptr(node->lru_prev);
             assert(prev != nullptr);
             _lockNode(prev, "insert.prev");
-            if (prev->lru_next != node) {
+            if (ptr(prev->lru_next) != node) {
                 if (Config::enable_debug) {
-                    if (prev == node->lru_prev) {
+                    if (prev == ptr(node->lru_prev)) {
                         std::cerr << "Whoa: new prev: " << dumpNode(new_prev) << '\n';
-                        std::cerr << "\t" << dumpNode(prev) << "->" << dumpNode(prev->lru_next)
-                                  << std::endl;
-                        std::cerr << "\t" << dumpNode(node->lru_prev) << "<-" << dumpNode(node)
-                                  << std::endl;
+                        std::cerr << "\t" << dumpNode(prev) << "->"
+                                  << dumpNode(ptr(prev->lru_next)) << std::endl;
+                        std::cerr << "\t" << dumpNode(ptr(node->lru_prev)) << "<-"
+                                  << dumpNode(node) << std::endl;
                         std::raise(SIGINT);
                     }
                 }
                 _unlockNode(prev, "insert.prev:next_changed");
+                lock_profiler_.retry(LockClass::Node);
                 continue;
             }
 
             _lockNode(node, "insert.next");
 
-            assert(prev->lru_next == node);
-            assert(prev == node->lru_prev);
+            assert(ptr(prev->lru_next) == node);
+            assert(prev == ptr(node->lru_prev));
 
-            prev->lru_next     = new_prev;
-            new_prev->lru_prev = prev;
-            new_prev->lru_next = node;
-            node->lru_prev     = new_prev;
+            prev->lru_next     = link(new_prev);
+            new_prev->lru_prev = link(prev);
+            new_prev->lru_next = link(node);
+            node->lru_prev     = link(new_prev);
 
             _unlockNode(prev, "insert.prev");
             _unlockNode(node, "insert.next");
@@ -401,14 +514,14 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
      * node:
      *   locked->locked
      */
-    void putNodeToPool(Node* node) { listInsertBefore(&pool_tail_, node); }
+    void putNodeToPool(Node* node) { listInsertBefore(poolTail(), node); }
 
     /**
      *
      * return:
      *   unlocked->locked
      */
-    Node* getNodeFromPool() { return listEvictNext(&pool_head_, &pool_tail_); }
+    Node* getNodeFromPool() { return listEvictNext(poolHead(), poolTail()); }
 
     /**
      * node:
@@ -416,14 +529,23 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
      */
     void lruInsertLast(Node* node) {
         profile_stats_.head_accesses++;
-        listInsertBefore(&lru_tail_, node);
+        if (young_count_) {
+            node->lru_stamp = lru_clock_.fetch_add(1, std::memory_order_relaxed);
+        }
+        listInsertBefore(lruTail(), node);
+    }
+
+    /// @param node expected to be locked
+    bool isYoung(const Node* node) const {
+        return young_count_ &&
+               lru_clock_.load(std::memory_order_relaxed) - node->lru_stamp < young_count_;
     }
 
     /**
      * return:
      *   unlocked->locked
      */
-    Node* lruEvictHead() { return listEvictNext(&lru_head_, &lru_tail_); }
+    Node* lruEvictHead() { return listEvictNext(lruHead(), lruTail()); }
 
     /**
      * return:
@@ -451,7 +573,7 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
 
         // lock parent
         while (true) {
-            prev = node->lru_prev;
+            prev = ptr(node->lru_prev);
             assert(prev != nullptr);
 
             if (_tryLockNode(prev, "lru.remove.prev")) {
@@ -460,7 +582,7 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
                 _unlockNode(node, "lru.remove.node:prev_locked");
                 _lockNode(prev, "lru.remove.prev");
 
-                if (prev->lru_next == node) {
+                if (ptr(prev->lru_next) == node) {
                     // prev haven't changed
                     _lockNode(node, "lru.remove.node:prev_same");
 
@@ -482,13 +604,14 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
                         return false;
                     } else {
                         // start again; node locked, prev is unlocked
+                        lock_profiler_.retry(LockClass::Node);
                         continue;
                     }
                 }
             }
         }
 
-        Node* next = node->lru_next;
+        Node* next = ptr(node->lru_next);
 
         if (Config::enable_debug) {
             assert(next != nullptr);
@@ -496,22 +619,22 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
                 // used to catch one sneaky bug
                 std::cerr << "Whoa:\n\t" << dumpNode(prev) << "::" << dumpNode(node)
                           << "::" << dumpNode(next) << '\n';
-                std::cerr << "\t" << dumpNode(prev) << "->" << dumpNode(prev->lru_next) << "->"
-                          << dumpNode(prev->lru_next->lru_next) << std::endl;
-                std::cerr << "\t" << dumpNode(next->lru_prev->lru_prev) << "<-"
-                          << dumpNode(next->lru_prev) << "<-" << dumpNode(next) << std::endl;
+                std::cerr << "\t" << dumpNode(prev) << "->" << dumpNode(ptr(prev->lru_next))
+                          << "->" << dumpNode(ptr(ptr(prev->lru_next)->lru_next)) << std::endl;
+                std::cerr << "\t" << dumpNode(ptr(ptr(next->lru_prev)->lru_prev)) << "<-"
+                          << dumpNode(ptr(next->lru_prev)) << "<-" << dumpNode(next) << std::endl;
                 std::raise(SIGINT);
             }
         }
 
         _lockNode(next, "lru.remove.next");
 
-        prev->lru_next = next;
-        next->lru_prev = prev;
+        prev->lru_next = link(next);
+        next->lru_prev = link(prev);
         _unlockNode(prev, "lru.remove.prev");
         _unlockNode(next, "lru.remove.next");
 
-        node->lru_next = node->lru_prev = nullptr;
+        node->lru_next = node->lru_prev = links_t::null();
 
         return true;
     }
@@ -530,10 +653,12 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         profile_stats_.evict++;
         backoff_t backoff1;
         while (!node->htFlag()) {
+            lock_profiler_.spin(LockClass::Node);
             backoff1.wait();
         }
         backoff_t backoff2;
         while (!htRemove(node)) {
+            lock_profiler_.spin(LockClass::Bucket);
             backoff2.wait();
         }
         deleter_.onDelete(std::move(node->key), std::move(node->value));
@@ -543,14 +668,14 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
     }
 
     size_t whichBucket(const key_t& k) const {
-        return (hasher_(k) >> IgnoreBitsInHash) % ht_.size();
+        return (hasher_(k) >> IgnoreBitsInHash) & ht_mask_;
     }
 
     void lockBucket(size_t bucket_nr) {
         if (HT_EXTERNAL_LOCK) {
-            ht_locks_[bucket_nr].lock();
+            lock_profiler_.lock(LockClass::Bucket, ht_locks_[bucket_nr], bucket_nr);
         } else {
-            ht_[bucket_nr].lock();
+            lock_profiler_.lock(LockClass::Bucket, ht_[bucket_nr], bucket_nr);
         }
     }
 
@@ -562,6 +687,27 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         }
     }
 
+    /// Lookups lock external bucket locks in shared mode if the lock has one
+    void lockBucketShared(size_t bucket_nr) {
+        if constexpr (SupportsSharedLock<lock_t>::value) {
+            if (HT_EXTERNAL_LOCK) {
+                lock_profiler_.lockShared(LockClass::Bucket, ht_locks_[bucket_nr], bucket_nr);
+                return;
+            }
+        }
+        lockBucket(bucket_nr);
+    }
+
+    void unlockBucketShared(size_t bucket_nr) {
+        if constexpr (SupportsSharedLock<lock_t>::value) {
+            if (HT_EXTERNAL_LOCK) {
+                ht_locks_[bucket_nr].unlock_shared();
+                return;
+            }
+        }
+        unlockBucket(bucket_nr);
+    }
+
     // insert to head
     // TODO: check no such node with a key?
     // bucket must be locked during operation
@@ -588,6 +734,20 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         return true;
     }
 
+    // Bulk load only, the bucket is owned by the calling thread
+    // fails if the key is already in the bucket
+    bool htInsertUnlocked(Node* node, size_t bucket_nr) {
+        for (NodeBase* current = ht_[bucket_nr].htNext(); current; current = current->htNext()) {
+            if (static_cast<Node*>(current)->key == node->key) {
+                return false;
+            }
+        }
+        node->htSetNext(ht_[bucket_nr].htNext());
+        ht_[bucket_nr].htSetNext(node);
+        node->htSetFlag(true);
+        return true;
+    }
+
     // Lock bucket and search node
     // TODO: check node locking
     // return:
@@ -601,7 +761,7 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         volatile bool        dump = false;
 #endif
 
-        lockBucket(bucket_nr);
+        lockBucketShared(bucket_nr);
         Node* node = reinterpret_cast<Node*>(ht_[bucket_nr].htNext());
 
         while (node) {
@@ -619,7 +779,7 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
             node = reinterpret_cast<Node*>(node->htNext());
         }
 
-        unlockBucket(bucket_nr);
+        unlockBucketShared(bucket_nr);
         return node;
     }
 
@@ -662,29 +822,55 @@ class ConcurrentLRU : public ContainerBase<Config, ConcurrentLRU<Config, IgnoreB
         return true;
     }
 
-    std::vector<Node>         data_;
-    std::vector<NodeBase>     ht_;
-    std::unique_ptr<lock_t[]> ht_locks_;
-    Node                      lru_head_;
-    Node                      lru_tail_;
-    Node                      pool_head_;
-    Node                      pool_tail_;
+    static constexpr size_t sentinelNodeCount() { return 3 * sentinelStride<Node>() + 1; }
+
+    Node* sentinel(size_t nr) const {
+        return const_cast<Node*>(&data_[this->max_element_count_ + nr * sentinelStride<Node>()]);
+    }
+
+    Node* lruHead() const { return sentinel(0); }
+
+    Node* lruTail() const { return sentinel(1); }
+
+    Node* poolHead() const { return sentinel(2); }
+
+    Node* poolTail() const { return sentinel(3); }
+
+    bool isDataNode(const Node* node) const {
+        return node >= data_.get() && node < data_.get() + this->max_element_count_;
+    }
+
+    Node* ptr(link_t l) const { return links_.toNode(l); }
+
+    link_t link(Node* node) const { return links_.toLink(node); }
+
+    NodeArray<Node>     data_;
+    links_t             links_;
+    NodeArray<NodeBase> ht_;
+    size_t              ht_mask_;
+    NodeArray<lock_t>   ht_locks_;
+
+    typename config::index_hasher_t      hasher_;
+    typename config::deletion_policy     deleter_;
+    typename config::profile_stats_t     profile_stats_;
+    typename config::lock_profiler_t     lock_profiler_;
+    typename config::promotion_sampler_t promotion_sampler_;
 
-    typename config::hasher_t        hasher_;
-    typename config::deletion_policy deleter_;
-    typename config::profile_stats_t profile_stats_;
+    double                                young_fraction_;
+    uint32_t                              young_count_ = 0; ///< 0 disables skipping
+    CACHELINE_ALIGN std::atomic<uint32_t> lru_clock_{0};    ///< appends to the LRU tail
 };
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-void ConcurrentLRU<Config, IgnoreBitsInHash>::assertIsCoherent() {
+template <typename Config, unsigned int IgnoreBitsInHash, typename NodeIndexT>
+void ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>::assertIsCoherent() {
     // all nodes in pool have unset flags not locked and value is deinitialized
     // all nodes in lru have unset flags not locked and value is initialized
     // all nodes in lru are in ht
     std::cerr << "pool: ";
-    dumpList(&pool_head_);
+    dumpList(poolHead());
     std::cerr << "\n";
     std::cerr << "lru:  ";
-    dumpList(&lru_head_);
+    dumpList(lruHead());
     std::cerr << "\n";
     profileStats().print(std::cerr);
     // dumpHt();
@@ -693,15 +879,14 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::assertIsCoherent() {
     bool raise = false;
 
     std::set<Node*> unseen_nodes;
-    for (auto& n : data_) {
-        unseen_nodes.insert(&n);
+    for (size_t i = 0; i < this->max_element_count_; i++) {
+        unseen_nodes.insert(&data_[i]);
     }
 
-    Node* node = &pool_head_;
+    Node* node = poolHead();
     Node* prev = node;
     while (true) {
-        if (node != &pool_head_ && node != &pool_tail_ &&
-            !(node >= data_.data() && node < data_.data() + data_.size())) {
+        if (node != poolHead() && node != poolTail() && !isDataNode(node)) {
             std::cerr << "Unknown pool node: " << dumpNode(node) << ", parent: " << dumpNode(prev)
                       << std::endl;
             raise = true;
@@ -712,8 +897,8 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::assertIsCoherent() {
             std::cerr << "A node in the pool is not coherent: " << dumpNode(node) << std::endl;
             raise = true;
         }
-        if (!node->lru_next) {
-            if (node != &pool_tail_) {
+        if (!ptr(node->lru_next)) {
+            if (node != poolTail()) {
                 std::cerr << "Last pool node is not the tail!\n";
                 raise = true;
             }
@@ -721,15 +906,14 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::assertIsCoherent() {
         }
         unseen_nodes.erase(node);
         prev = node;
-        node = node->lru_next;
+        node = ptr(node->lru_next);
     }
 
     std::set<Node*> lru_nodes;
-    node = &lru_head_;
+    node = lruHead();
     prev = node;
     while (true) {
-        if (node != &lru_head_ && node != &lru_tail_ &&
-            !(node >= data_.data() && node < data_.data() + data_.size())) {
+        if (node != lruHead() && node != lruTail() && !isDataNode(node)) {
             std::cerr << "Unknown lru node:  " << dumpNode(node) << ", parent: " << dumpNode(prev)
                       << std::endl;
             raise = true;
@@ -742,15 +926,15 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::assertIsCoherent() {
         }
         lru_nodes.insert(node);
         unseen_nodes.erase(node);
-        if (!node->lru_next) {
-            if (node != &lru_tail_) {
+        if (!ptr(node->lru_next)) {
+            if (node != lruTail()) {
                 std::cerr << "Last LRU node is not the tail!\n";
                 raise = true;
             }
             break;
         }
 
-        node = node->lru_next;
+        node = ptr(node->lru_next);
     }
 
     if (!unseen_nodes.empty()) {
@@ -793,26 +977,26 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::assertIsCoherent() {
     }
 }
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-void ConcurrentLRU<Config, IgnoreBitsInHash>::dump() {
+template <typename Config, unsigned int IgnoreBitsInHash, typename NodeIndexT>
+void ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>::dump() {
     std::cout << "LRU:\n  ";
-    Node* node = &pool_head_;
+    Node* node = poolHead();
     while (node) {
         std::cout << " -> " << dumpNode(node);
-        node = node->lru_next;
+        node = ptr(node->lru_next);
     }
     std::cout << "\n  ";
 
-    node = &lru_head_;
+    node = lruHead();
     while (node) {
         std::cout << " -> " << dumpNode(node);
-        node = node->lru_next;
+        node = ptr(node->lru_next);
     }
     std::cout << "\n\n";
 }
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-void ConcurrentLRU<Config, IgnoreBitsInHash>::dumpList(ConcurrentLRU::Node* node) {
+template <typename Config, unsigned int IgnoreBitsInHash, typename NodeIndexT>
+void ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>::dumpList(ConcurrentLRU::Node* node) {
     bool            first = true;
     std::set<Node*> seen;
     char            name[100];
@@ -829,27 +1013,28 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::dumpList(ConcurrentLRU::Node* node
             break;
         }
         seen.insert(node);
-        node = node->lru_next;
+        node = ptr(node->lru_next);
     }
 }
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-std::string ConcurrentLRU<Config, IgnoreBitsInHash>::dumpNode(ConcurrentLRU::Node* node) {
+template <typename Config, unsigned int IgnoreBitsInHash, typename NodeIndexT>
+std::string
+ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>::dumpNode(ConcurrentLRU::Node* node) {
     if (node == nullptr) {
         return "NULL";
     }
     std::string name;
-    if (node == &lru_head_) {
+    if (node == lruHead()) {
         name = "lru_head";
-    } else if (node == &lru_tail_) {
+    } else if (node == lruTail()) {
         name = "lru_tail";
-    } else if (node == &pool_head_) {
+    } else if (node == poolHead()) {
         name = "pool_head";
-    } else if (node == &pool_tail_) {
+    } else if (node == poolTail()) {
         name = "pool_tail";
     } else {
-        auto idx = node - data_.data();
-        if (idx < data_.size()) {
+        auto idx = node - data_.get();
+        if (isDataNode(node)) {
             name = std::to_string(idx);
         } else {
             char buf[80];
@@ -865,8 +1050,8 @@ std::string ConcurrentLRU<Config, IgnoreBitsInHash>::dumpNode(ConcurrentLRU::Nod
     return name;
 }
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-void ConcurrentLRU<Config, IgnoreBitsInHash>::dumpHt() {
+template <typename Config, unsigned int IgnoreBitsInHash, typename NodeIndexT>
+void ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>::dumpHt() {
     std::cerr << "HT:\n";
     for (size_t i = 0; i < ht_.size(); i++) {
         std::cerr << "  [" << i << "]:";
@@ -888,25 +1073,24 @@ void ConcurrentLRU<Config, IgnoreBitsInHash>::dumpHt() {
     }
 }
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-void ConcurrentLRU<Config, IgnoreBitsInHash>::dumpNodeExt(char*                      buf,
-                                                          const ConcurrentLRU::Node* node,
-                                                          bool print_addr) const {
+template <typename Config, unsigned int IgnoreBitsInHash, typename NodeIndexT>
+void ConcurrentLRU<Config, IgnoreBitsInHash, NodeIndexT>::dumpNodeExt(
+    char* buf, const ConcurrentLRU::Node* node, bool print_addr) const {
     const char* name = "";
     char        idx_buf[100];
     if (node == nullptr) {
         name = "NULL";
-    } else if (node == &lru_head_) {
+    } else if (node == lruHead()) {
         name = "lru_head";
-    } else if (node == &lru_tail_) {
+    } else if (node == lruTail()) {
         name = "lru_tail";
-    } else if (node == &pool_head_) {
+    } else if (node == poolHead()) {
         name = "pool_head";
-    } else if (node == &pool_tail_) {
+    } else if (node == poolTail()) {
         name = "pool_tail";
     } else {
-        auto idx = node - data_.data();
-        if (idx < data_.size()) {
+        auto idx = node - data_.get();
+        if (isDataNode(node)) {
             sprintf(idx_buf, "%zd", idx);
             name = idx_buf;
         } else {
@@ -2,8 +2,13 @@
 
 #include <boost/functional/hash.hpp>
 
+#include <functional>
 #include <mutex>
+#include <type_traits>
 
+#include "containers/promotion.h"
+#include "lock_profiler.h"
+#include "locks.h"
 #include "utility.h"
 
 struct TrivialHash {
@@ -13,6 +18,36 @@ struct TrivialHash {
     }
 };
 
+/**
+ * Hashes that return the key itself (or nearly so) for integers.
+ * Low bits of such a hash are not uniformly distributed,
+ * so they must be mixed before being masked into a bucket index.
+ */
+template <typename HasherT>
+struct IsWeakHash : std::false_type {};
+
+template <>
+struct IsWeakHash<TrivialHash> : std::true_type {};
+
+template <typename Int>
+struct IsWeakHash<std::hash<Int>> : std::is_integral<Int> {};
+
+template <typename Int>
+struct IsWeakHash<boost::hash<Int>> : std::is_integral<Int> {};
+
+/**
+ * Hasher used for table indexing. Applies mixHash finalizer
+ * on top of a weak hash, strong hashes are used as is.
+ */
+template <typename HasherT>
+struct IndexHash : HasherT {
+    template <typename KeyT>
+    inline size_t operator()(const KeyT& key) const {
+        size_t h = HasherT::operator()(key);
+        return IsWeakHash<HasherT>::value ? mixHash(h) : h;
+    }
+};
+
 struct EmptyDeletePolicy {
     template <typename KeyT, typename ValueT>
     void onDelete(const KeyT&, const ValueT&) {}
@@ -30,11 +65,18 @@ struct EmptyDeletePolicy {
  *
  * @tparam HasherT
  *          - size_t operator()(KeyT)
+ *          // Containers index tables with index_hasher_t,
+ *          // which mixes weak hashes (see IsWeakHash)
  *
  * @tparam LockingT
  *          - void lock()
  *          - void unlock()
  *          - bool try_lock()
+ *          // Optional shared mode (see SupportsSharedLock),
+ *          // hash table lookups of DeferredLRU and ConcurrentLRU use it:
+ *          - void lock_shared()
+ *          - void unlock_shared()
+ *          - bool try_lock_shared()
  *
  * @tparam DeletionPolicy
  *          - void on_delete(KeyT, ValueT)
@@ -46,22 +88,28 @@ struct EmptyDeletePolicy {
  *
  * @tparam EnableProfile
  *          // Enable additional logging
+ *
+ * promotion_sampler_t decides which hits of LRUCache, ConcurrentLRU
+ * and DeferredLRU are promoted (see PromotionSampling).
  */
 
 template <typename KeyT, typename ValueT, typename HasherT, typename CompT, typename LockingT,
           typename DeletionPolicy = EmptyDeletePolicy, int HashTableLoadFactor = 4,
           bool EnableDebug = false, bool EnableProfile = false>
 struct ContainerConfig {
-    using key_t            = KeyT;
-    using value_t          = ValueT;
-    using hasher_t         = HasherT;
-    using comparator_t     = CompT;
-    using locking_t        = LockingT;
-    using lock_guard_t     = std::lock_guard<locking_t>;
-    using deletion_policy  = DeletionPolicy;
-    using idx_t            = size_t;
-    using metric_counter_t = std::conditional_t<false, MetricCounterImpl, MetricCounterStub>;
-    using profile_stats_t  = ProfileStats<EnableProfile>;
+    using key_t               = KeyT;
+    using value_t             = ValueT;
+    using hasher_t            = HasherT;
+    using index_hasher_t      = IndexHash<HasherT>;
+    using comparator_t        = CompT;
+    using locking_t           = LockingT;
+    using lock_guard_t        = std::lock_guard<locking_t>;
+    using deletion_policy     = DeletionPolicy;
+    using idx_t               = size_t;
+    using metric_counter_t    = std::conditional_t<false, MetricCounterImpl, MetricCounterStub>;
+    using profile_stats_t     = ProfileStats<EnableProfile>;
+    using lock_profiler_t     = LockProfiler<EnableProfile>;
+    using promotion_sampler_t = PromotionSampler;
 
     enum { enable_debug = EnableDebug, enable_profile = EnableProfile };
 
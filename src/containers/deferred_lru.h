@@ -1,12 +1,21 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <mutex>
+#include <string>
 #include <vector>
 
+#include "containers/bulk_load.h"
 #include "containers/container_base.h"
+#include "containers/node_array.h"
+#include "containers/node_links.h"
+#include "containers/snapshot.h"
+#include "containers/swiss_index.h"
 
 /**
  * # DeferredLRU
@@ -66,8 +75,10 @@
  *                    FIXME: head->next should not be touched by PURGE/PULL
  *                    FIXME: head is concurrently changed (locking?)
  *     - UPDATE CAPACITY - increase node count and dynamic size memory count
- *     - GET RECENT SLICE - get head of the current recent list.
+ *     - GET RECENT SLICE - get head of the current recent list shard.
  *                          Can be done only by a thread with recent list token.
+ *                          Each thread marks nodes in its own shard,
+ *                          shards are drained together by PULL RECENT.
  *     - EVICT FROM LRU - remove node from a LRU list
  *                        FIXME: don't remove node that is referred by head
  *     - BULK ADD TO LRU - atomically insert a sublist into LRU head
@@ -79,7 +90,7 @@
  *
  * ### Find
  *   > h := hash(key)
- *   > bucked := ht[h % ht_size]
+ *   > bucked := ht[h & (ht_size - 1)]
  *   > lock bucket
  *   >   found := traverse items
  *   >   if found:
@@ -110,7 +121,7 @@
  *   > UPDATE CAPACITY with node
  *   >
  *   > h := hash(key)
- *   > bucked := ht[h % ht_size]
+ *   > bucked := ht[h & (ht_size - 1)]
  *   > lock bucket
  *   >   add node to bucket
  *   >   unlock bucket
@@ -127,13 +138,14 @@
  *   > if failed:
  *   >   exit (other thread is already handling this)
  *   >
- *   > recent_head := GET RECENT SLICE
  *   > lru_temp_head := NONE
  *   >
- *   > for each node in head:
- *   >   evict node from LRU
- *   >   FIXME: LRU head refers to node
- *   >   append node to a lru_temp_head
+ *   > for each recent shard:
+ *   >   recent_head := GET RECENT SLICE
+ *   >   for each node in head:
+ *   >     evict node from LRU
+ *   >     FIXME: LRU head refers to node
+ *   >     append node to a lru_temp_head
  *   >
  *   > BULK ADD lru_temp_head TO LRU
  *   > FIXME: how to atomically reset all recent_link? (refer to flag)
@@ -145,17 +157,25 @@
  *   > if failed:
  *   >   exit (other thread is already handling this)
  *   >
- *   > traverse backward from LRU tail
- *   >   TODO: handle RECENT nodes with stub links
- *   >   if node is RECENT:
- *   >     try REMOVE FROM BUCKET
- *   >       if success:
+ *   > while not enough nodes freed:
+ *   >   tail_segment := traverse backward from LRU tail
+ *   >                   (never including LRU head neighbor)
+ *   >   detach tail_segment from LRU in one step
+ *   >   sort tail_segment nodes by bucket lock
+ *   >   for each group of nodes sharing a bucket lock:
+ *   >     lock bucket
+ *   >     for each node in group:
+ *   >       if node is RECENT:
+ *   >         append node to lru_temp_head
+ *   >       else:
+ *   >         REMOVE FROM BUCKET
  *   >         delete content
- *   >         ADD node TO POOL
- *   >   # else we just skip it, it will be handled
- *   >   # by the followed PULL RECENT operation
- *   > PULL RECENT
- *   > TODO: try to take whole tail as a sublist (tag pointer?)
+ *   >         append node to pool_temp_head
+ *   >     unlock bucket
+ *   >   BULK ADD lru_temp_head TO LRU
+ *   >   # RECENT nodes stay in their recent list, they will be
+ *   >   # moved again by the followed PULL RECENT operation
+ *   >   ADD pool_temp_head TO POOL
  *
  *
  * - dynamic memory
@@ -171,6 +191,42 @@
  *  - value retrieval in concurrent environment
  * - parameter search (purge limit/pull limit)
  *
+ * ## Node layout
+ * With NodeIndexT = void nodes are linked with pointers.
+ * With uint32_t or uint16_t they are linked with indices into the node array
+ * (see NodeLinks), which cuts node metadata from 40 to 20 or 10 bytes.
+ * 16-bit indices fit only small caches, e.g. shards of BucketedAdapter.
+ * LRU head/tail, the recent list terminal and the head/tail of the list
+ * collected by a pull are sentinel nodes at the start of the node array,
+ * so they are addressable in both layouts and data nodes can be appended
+ * when the cache grows. Nodes on the stack can't be linked by index,
+ * so pull and purge never link to local nodes.
+ *
+ * With SplitPayload key/value pairs are kept in a separate array indexed
+ * by node id. Pull and purge walk only links and recent marks,
+ * so more nodes fit into a cache line; lookups touch the payload array
+ * and the links of the found node only.
+ *
+ * ## Hash index
+ * By default the hash table is an array of cache line sized bucket blocks.
+ * A block holds its own lock and up to kBucketSlots (fingerprint, node index)
+ * pairs, so a lookup reads one cache line and dereferences only nodes
+ * with a matching 8-bit fingerprint. Nodes that do not fit into a full block
+ * are chained through bucket_next from the block overflow pointer.
+ * With UseSwissIndex it is a ConcurrentSwissIndex over node indices,
+ * where a bucket is a probe window of the home group and bucket lock is a window lock.
+ *
+ * ## Resize
+ * resize() changes the capacity while the cache is in use.
+ * Node arrays are reserved for NodePlacement::max_growth times the capacity,
+ * growing constructs nodes in the reserve in steps of kResizeStep and adds them to the pool.
+ * The table grows by linear hashing, one bucket split at a time under the bucket lock,
+ * and a thread that locked a bucket looks its number up again in case it was split meanwhile.
+ * The swiss index is allocated for the whole reserve instead.
+ * Shrinking retires nodes from the pool, purging the LRU tail when the pool runs dry.
+ * Retired nodes are kept for regrowth. Splits and pool changes are done under the LRU lock,
+ * so they never race with a pull or a purge.
+ *
  * ## Notes
  *
  * - Comparison with Bag-LRU
@@ -179,138 +235,352 @@
  * - Memory barrier on when adding to recent list
  */
 
-template <typename T>
-bool ptrIsMarked(const T* p) {
-    return uintptr_t(p) & 1;
-}
-
-template <typename T>
-T* markPtr(T* p) {
-    return reinterpret_cast<T*>(uintptr_t(p) | 1u);
-}
-
-template <typename T>
-T* extractPtr(T* p) {
-    return reinterpret_cast<T*>(uintptr_t(p) & ~uintptr_t(1));
-}
-
-template <typename Config>
-class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
+template <typename Config, bool UseSwissIndex = false, typename NodeIndexT = void,
+          bool SplitPayload = false>
+class DeferredLRU
+    : public ContainerBase<Config, DeferredLRU<Config, UseSwissIndex, NodeIndexT, SplitPayload>,
+                           true> {
   public:
-    using config  = Config;
-    using base_t  = ContainerBase<Config, DeferredLRU<Config>, true>;
+    using config = Config;
+    using base_t =
+        ContainerBase<Config, DeferredLRU<Config, UseSwissIndex, NodeIndexT, SplitPayload>, true>;
     using key_t   = typename config::key_t;
     using value_t = typename config::value_t;
     using lock_t  = typename config::locking_t;
+    using swiss_t = ConcurrentSwissIndex<uint32_t, lock_t>;
 
     template <typename T>
     using atomic_t = std::atomic<T>;
 
   private:
-    /**
-     * Defined with idea, that for T thread probability of 2 threads accessing the same lock should
-     * be <= p. Probability is calculated as in birthday paradox. With T = 48, p ~= 0.03, size :=
-     * 2^15
-     */
-    static constexpr size_t maxBucketLockSize() { return 1 << 15; }
+    struct NodeBase;
+    struct InlineNode;
 
-    static constexpr size_t bucketLockIndexMask() {
-        return maxBucketLockSize() - 1; // gives 000111 mask for MAX=001000
-    }
+    /// Element of the node array
+    using Node    = std::conditional_t<SplitPayload, NodeBase, InlineNode>;
+    using links_t = NodeLinks<NodeBase, Node, NodeIndexT>;
+    using link_t  = typename links_t::link_t;
+
+    /// Bytes taken by the overflow link and the lock, including padding before the slots
+    static constexpr size_t kBucketHeaderSize =
+        ((sizeof(link_t) + alignof(lock_t) - 1) / alignof(lock_t) * alignof(lock_t) +
+         sizeof(lock_t) + 3) /
+        4 * 4;
+
+    /// Number of inline slots that fit into a cache line next to the lock and overflow link
+    static constexpr size_t kBucketSlots =
+        kBucketHeaderSize < 64 ? (64 - kBucketHeaderSize - 1) / (sizeof(uint32_t) + 1) : 0;
+
+    static_assert(kBucketSlots > 0, "Bucket lock does not fit into a cache line");
+
+    /// Nodes added or retired and buckets split by resize() per LRU lock acquisition
+    static constexpr size_t kResizeStep   = 1024;
+    static constexpr size_t kResizeSplits = 256;
 
     struct NodeBase {
-        atomic_t<NodeBase*> lru_next    = {nullptr};
-        atomic_t<NodeBase*> lru_prev    = {nullptr};
-        atomic_t<NodeBase*> recent_next = {nullptr};
-        atomic_t<NodeBase*> empty_next  = {nullptr};
-        NodeBase*           bucket_next = {nullptr};
+        atomic_t<link_t> lru_next    = {links_t::null()};
+        atomic_t<link_t> lru_prev    = {links_t::null()};
+        atomic_t<link_t> recent_next = {links_t::null()};
+        atomic_t<link_t> empty_next  = {links_t::null()};
+        link_t           bucket_next = {links_t::null()};
     };
 
-    struct Node : NodeBase {
+    struct Payload {
         key_t   key;
         value_t value;
     };
 
-    struct BucketHead {
-        Node* bucket_next = nullptr;
+    struct InlineNode : NodeBase, Payload {};
+
+    /**
+     * Slots [0, count) are used and kept contiguous.
+     * Overflow nodes are only present when all slots are used.
+     */
+    struct CACHELINE_ALIGN BucketBlock {
+        link_t   overflow = links_t::null();
+        lock_t   lock;
+        uint32_t slots[kBucketSlots];
+        uint8_t  count = 0;
+        uint8_t  fingerprints[kBucketSlots];
+    };
+
+    static_assert(sizeof(BucketBlock) == 64, "Bucket block must fit into a cache line");
+
+    /**
+     * One of the recent lists. Each thread pushes recently accessed nodes
+     * to its own shard, so hits from different threads do not contend
+     * on a single head. The count is approximate and is only used
+     * to decide when a pull should be requested.
+     */
+    struct RecentShard {
+        CACHELINE_ALIGN atomic_t<link_t> head;
+        CACHELINE_ALIGN atomic_t<size_t> count;
     };
 
   public:
     explicit DeferredLRU(size_t capacity = 0, bool is_item_capacity = false,
-                         double pull_threshold_factor = 0.1, double purge_threshold_factor = 0.1) {
+                         double pull_threshold_factor = 0.1, double purge_threshold_factor = 0.1,
+                         size_t recent_shard_count = 1) {
         /// initialize a cache that stores size objects.
         /// Subsequently added object will cause an eviction.
-        allocateMemory(capacity, is_item_capacity, pull_threshold_factor, purge_threshold_factor);
+        allocateMemory(capacity, is_item_capacity, pull_threshold_factor, purge_threshold_factor,
+                       recent_shard_count);
     }
 
     ~DeferredLRU() { releaseMemory(); }
 
-    static const char* name() { return "DeferredLRU-2"; }
+    static const char* name() {
+        if (UseSwissIndex) {
+            return "DeferredLRU-2_Swiss";
+        }
+        if (SplitPayload) {
+            return "DeferredLRU-2_SoA";
+        }
+        return links_t::is_index ? "DeferredLRU-2_Compact" : "DeferredLRU-2";
+    }
 
     decltype(auto) profileStats() const { return profile_stats_.getSlice(); }
 
+    LockProfileReport lockProfile() const { return lock_profiler_.report(); }
+
     size_t currentOverheadMemory() const {
-        return sizeof(BucketHead) * buckets_.size() +
-               sizeof(lock_t) * std::min(buckets_.size(), maxBucketLockSize()) +
-               (sizeof(Node) - sizeof(key_t) - sizeof(value_t)) * this->current_element_count_;
+        return sizeof(BucketBlock) * bucket_count_ + sizeof(RecentShard) * recent_shard_count_ +
+               swiss_index_.memoryUsage() +
+               (nodeSize() - sizeof(key_t) - sizeof(value_t)) * this->current_element_count_;
     }
 
     static double elementSize() {
-        return sizeof(Node) + sizeof(BucketHead) / (double)config::hashTableLoadFactor();
+        if (UseSwissIndex) {
+            return nodeSize() + swiss_t::bytesPerElement();
+        }
+        return nodeSize() + sizeof(BucketBlock) / (double)config::hashTableLoadFactor();
     }
 
     void allocateMemory(size_t capacity, bool is_item_capacity, double pull_threshold_factor = 0.1,
-                        double purge_threshold_factor = 0.1) {
+                        double purge_threshold_factor = 0.1, size_t recent_shard_count = 1) {
         this->init(capacity, is_item_capacity);
         if (capacity == 0) {
             return;
         }
 
-        buckets_.assign(getBucketCountForCapacity(this->max_element_count_), BucketHead());
-        if (buckets_.size() < 4) {
-            throw std::runtime_error("Too small capacity");
+        // both indexes store 32-bit node indices
+        if (this->max_element_count_ >= std::numeric_limits<uint32_t>::max() ||
+            this->max_element_count_ + sentinelNodeCount() > links_t::maxNodeCount()) {
+            throw std::runtime_error("Too large capacity");
+        }
+        size_t reserve =
+            std::min({NodePlacement::global().reserveCount(this->max_element_count_),
+                      std::numeric_limits<uint32_t>::max() - sentinelNodeCount(),
+                      links_t::maxNodeCount() - sentinelNodeCount()});
+
+        if (UseSwissIndex) {
+            swiss_index_.allocate(reserve);
+            lock_profiler_.trackBuckets(swiss_index_.lockCount());
+        } else {
+            bucket_count_ = getBucketCountForCapacity(this->max_element_count_);
+            if (bucket_count_ < 4) {
+                throw std::runtime_error("Too small capacity");
+            }
+            buckets_.reserve(bucket_count_, getBucketCountForCapacity(reserve));
+            lock_profiler_.trackBuckets(buckets_.capacity());
+        }
+        nodes_.reserve(sentinelNodeCount() + this->max_element_count_,
+                       sentinelNodeCount() + reserve);
+        links_.reset(&nodes_[0]);
+        if (SplitPayload) {
+            payloads_.reserve(this->max_element_count_, reserve);
+        }
+        node_count_    = this->max_element_count_;
+        retired_head_  = links_t::null();
+        retired_count_ = 0;
+
+        pull_threshold_factor_  = pull_threshold_factor;
+        purge_threshold_factor_ = purge_threshold_factor;
+        recent_shard_count_     = std::max<size_t>(recent_shard_count, 1);
+        recent_shards_.reset(new RecentShard[recent_shard_count_]);
+        updateThresholds();
+
+        purge_buffer_.reserve(std::max<size_t>(purge_threshold_, 20));
+
+        lruHead()->lru_prev = links_t::null();
+        lruHead()->lru_next = link(lruTail());
+        lruTail()->lru_prev = link(lruHead());
+        lruTail()->lru_next = links_t::null();
+
+        for (size_t i = 0; i < recent_shard_count_; i++) {
+            recent_shards_[i].head  = link(recentDummyTerminalPtr());
+            recent_shards_[i].count = 0;
         }
-        bucket_locks_.reset(new lock_t[std::min(buckets_.size(), maxBucketLockSize())]);
-        nodes_.reset(new Node[this->max_element_count_]);
-        pull_threshold_ =
-            std::max<size_t>(size_t(pull_threshold_factor * this->max_element_count_), 1);
-        purge_threshold_ =
-            std::max<size_t>(size_t(purge_threshold_factor * this->max_element_count_), 1);
-
-        lru_head_.lru_prev = nullptr;
-        lru_head_.lru_next = &lru_tail_;
-        lru_tail_.lru_prev = &lru_head_;
-        lru_tail_.lru_next = nullptr;
-
-        recent_head_  = recentDummyTerminalPtr();
-        recent_count_ = 0;
 
         pull_request_  = false;
         purge_request_ = false;
 
-        empty_head_ = &nodes_[0];
-        for (size_t i = 0; i < this->max_element_count_ - 1; i++) {
-            nodes_[i].empty_next = &nodes_[i + 1];
+        empty_head_ = link(dataNode(0));
+        for (size_t i = 0; i < node_count_ - 1; i++) {
+            dataNode(i)->empty_next = link(dataNode(i + 1));
         }
-        nodes_[this->max_element_count_ - 1].lru_next = nullptr;
+        dataNode(node_count_ - 1)->empty_next = links_t::null();
 
         profile_stats_.reset();
     }
 
+    /**
+     * Fingerprint of a hash in the bucket blocks. Low bits select the bucket
+     * and adapters pick the shard by the high bits (BucketedAdapter, NumaShardedAdapter),
+     * so it is taken from the middle bits, which vary among the keys of one bucket of one shard.
+     */
+    static uint8_t fingerprint(size_t hash) { return uint8_t(hash >> 32u); }
+
+    /// Largest item capacity resize() accepts, fixed when the memory is allocated
+    size_t maxCapacity() const {
+        return nodes_.capacity() > sentinelNodeCount() ? nodes_.capacity() - sentinelNodeCount()
+                                                       : 0;
+    }
+
+    /**
+     * Change the capacity while the cache is in use, see Resize.
+     * Only one resize may run at a time.
+     *
+     * Nodes never move, so the cache grows only into the node array reserved
+     * by allocateMemory(). Set NodePlacement::global().max_growth to the largest
+     * growth factor before the cache is constructed; with the default of 1
+     * the capacity can be lowered and raised again up to the initial one only.
+     *
+     * @param capacity at most maxCapacity()
+     * @param is_item_capacity
+     * @throw std::runtime_error if capacity exceeds maxCapacity()
+     */
+    void resize(size_t capacity, bool is_item_capacity = true) {
+        size_t count = is_item_capacity ? capacity : this->maxElementCountForCapacity(capacity);
+        if (count == 0) {
+            throw std::runtime_error("Too small capacity");
+        }
+        if (sentinelNodeCount() + count > nodes_.capacity()) {
+            throw std::runtime_error("Capacity exceeds the reserve of " +
+                                     std::to_string(maxCapacity()) +
+                                     " items, see NodePlacement::max_growth");
+        }
+
+        bool done = false;
+        while (!done) {
+            // only resize takes nodes from the reserve, so they are constructed without the lock
+            size_t constructed = std::max(node_count_, std::min(node_count_ + kResizeStep, count));
+            nodes_.grow(sentinelNodeCount() + constructed);
+            if (SplitPayload) {
+                payloads_.grow(constructed);
+            }
+
+            lock_profiler_.lock(LockClass::Lru, lru_lock_);
+            done = resizeStep(count, constructed);
+            lru_lock_.unlock();
+        }
+    }
+
+    /**
+     * Write the nodes to a snapshot file from the LRU head to the tail,
+     * i.e. from the most to the least recently used one.
+     * Pending recent nodes are pulled first. The LRU lock is held meanwhile,
+     * so lookups and inserts go on, but nothing is purged.
+     *
+     * @param path
+     * @return number of written nodes
+     */
+    size_t saveSnapshot(const std::string& path) {
+        SnapshotWriter<key_t, value_t> writer(path);
+        {
+            lock_profiler_.lock(LockClass::Lru, lru_lock_);
+            std::lock_guard<std::mutex> lg(lru_lock_, std::adopt_lock);
+            pullRecent();
+            // nodes inserted at the head meanwhile are skipped
+            NodeBase* node = ptr(lruHead()->lru_next.load(std::memory_order_acquire));
+            while (node != lruTail()) {
+                Payload& item = payload(static_cast<Node*>(node));
+                writer.write(item.key, item.value);
+                node = ptr(node->lru_next.load(std::memory_order_acquire));
+            }
+        }
+        return writer.finish();
+    }
+
+    /**
+     * Fill an empty cache from a snapshot file with bulkLoad,
+     * no other thread may use the cache meanwhile.
+     * Records beyond the capacity are the least recently used ones and are skipped.
+     *
+     * @param path
+     * @param threads 0 is omp_get_max_threads()
+     * @return number of loaded nodes
+     */
+    size_t loadSnapshot(const std::string& path, unsigned threads = 0) {
+        if (lruHead()->lru_next.load(std::memory_order_relaxed) != link(lruTail())) {
+            throw std::runtime_error("Snapshot can only be loaded into an empty cache");
+        }
+        SnapshotReader<key_t, value_t> reader(path);
+        return bulkBuild(reader.size(), threads,
+                         [records = reader.begin()](size_t i, Payload& item) {
+                             item.key   = records[i].key;
+                             item.value = records[i].value;
+                         });
+    }
+
+    /**
+     * Insert key/value pairs (first, second) into an empty or quiesced cache,
+     * no other thread may use the cache meanwhile.
+     * Nodes are taken from the pool and linked into buckets and the LRU list directly:
+     * buckets are split into ranges built by different threads (see BulkLoadPartition),
+     * so no bucket lock is taken, and the LRU head is updated once.
+     * The range goes from the most to the least recently used pair
+     * and becomes more recent than the nodes already in the cache.
+     * Pairs that don't fit into the pool and keys that are already present are skipped.
+     *
+     * @tparam RandomIt
+     * @param first
+     * @param last
+     * @param threads 0 is omp_get_max_threads()
+     * @return number of inserted nodes
+     */
+    template <typename RandomIt>
+    size_t bulkLoad(RandomIt first, RandomIt last, unsigned threads = 0) {
+        return bulkBuild(size_t(last - first), threads, [first](size_t i, Payload& item) {
+            item.key   = first[i].first;
+            item.value = first[i].second;
+        });
+    }
+
     /// calls the eviction policy on all the objects in the cache
     void releaseMemory() {
-        for (BucketHead& bucket : buckets_) {
-            Node* node = bucket.bucket_next;
+        for (size_t i = 0; i < bucket_count_; i++) {
+            BucketBlock& bucket = buckets_[i];
+            for (size_t slot = 0; slot < bucket.count; slot++) {
+                Payload& item = payload(&nodes_[bucket.slots[slot]]);
+                deleter_.onDelete(std::move(item.key), std::move(item.value));
+            }
+            Node* node = nodeAt(bucket.overflow);
             while (node) {
-                deleter_.onDelete(std::move(node->key), std::move(node->value));
-                node = (Node*)(node->bucket_next);
+                deleter_.onDelete(std::move(payload(node).key), std::move(payload(node).value));
+                node = nodeAt(node->bucket_next);
             }
         }
+        if (nodes_) {
+            swiss_index_.forEach([this](uint32_t idx) {
+                Payload& item = payload(&nodes_[idx]);
+                deleter_.onDelete(std::move(item.key), std::move(item.value));
+            });
+        }
 
+        swiss_index_.release();
         nodes_.reset();
-        buckets_.clear();
-        buckets_.shrink_to_fit();
-        bucket_locks_.reset();
+        payloads_.reset();
+        links_.reset(nullptr);
+        buckets_.reset();
+        bucket_count_  = 0;
+        node_count_    = 0;
+        retired_head_  = links_t::null();
+        retired_count_ = 0;
+        recent_shards_.reset();
+        recent_shard_count_ = 0;
+        purge_buffer_.clear();
+        purge_buffer_.shrink_to_fit();
     }
 
     /**
@@ -328,20 +598,21 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
     bool find(const key_t& key, ValueConsumer& consumer) {
         profile_stats_.find++;
 
-        auto bucket_nr = keyToBucketNr(key);
-        lockBucket(bucket_nr);
+        size_t hash      = hasher_(key);
+        size_t bucket_nr = lockHashBucket<true>(hash);
 
-        Node* node  = searchBucket(key, bucket_nr);
+        Node* node  = searchBucket(key, hash, bucket_nr);
         bool  found = node != nullptr;
 
+        RecentShard& shard = currentRecentShard();
         if (found) {
-            consumer = node->value;
-            markNodeRecent(node);
+            consumer = payload(node).value;
+            markNodeRecent(node, shard);
         }
 
-        unlockBucket(bucket_nr);
+        unlockBucketShared(bucket_nr);
 
-        if (recentThresholdHit()) {
+        if (recentThresholdHit(shard)) {
             requestPull();
         }
 
@@ -389,15 +660,16 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
         // get new node from pool
         // if pool is empty, we may trigger purge op to find some
         // or SPIN if other thread is currently doing it
-        Node* node  = allocateNode();
-        node->key   = std::forward<ForwardKeyT>(key);
-        node->value = std::forward<ForwardValueT>(value);
+        Node*    node = allocateNode();
+        Payload& item = payload(node);
+        item.key      = std::forward<ForwardKeyT>(key);
+        item.value    = std::forward<ForwardValueT>(value);
 
         // prevent node from being marked as recent since it's not in LRU yet
-        node->recent_next.store(recentDummyTerminalPtr(), std::memory_order_seq_cst);
+        node->recent_next.store(link(recentDummyTerminalPtr()), std::memory_order_seq_cst);
 
         if (!addNodeToBucket(node)) {
-            deleter_.onDelete(std::move(node->key), std::move(node->value));
+            deleter_.onDelete(std::move(item.key), std::move(item.value));
             disposeNode(node);
             return;
             // this->current_element_count_--;
@@ -405,7 +677,7 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
 
         addNodeToLruHead(node);
         // node now can participate in recent list
-        node->recent_next.store(nullptr, std::memory_order_release);
+        node->recent_next.store(links_t::null(), std::memory_order_release);
     }
 
     /**
@@ -439,7 +711,10 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
      */
     void dump(const char* msg = nullptr);
 
-    void resetProfiler() { profile_stats_.reset(); }
+    void resetProfiler() {
+        profile_stats_.reset();
+        lock_profiler_.reset();
+    }
 
   private:
     const char* ptrName(void* ptr, char* ext_buf = nullptr);
@@ -449,8 +724,7 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
     }
 
     static size_t getBucketCountForCapacity(size_t capacity) {
-        return (size_t)(capacity + config::hashTableLoadFactor() - 1) /
-               config::hashTableLoadFactor();
+        return bucketCountForLoadFactor(capacity, config::hashTableLoadFactor());
     }
 
     bool requestPull() {
@@ -464,7 +738,7 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
     }
 
     bool consolidateCache() {
-        if (lru_lock_.try_lock()) {
+        if (lock_profiler_.tryLock(LockClass::Lru, lru_lock_)) {
             if (purge_request_) {
                 purgeOld(20);
                 // purge_request_ = false;
@@ -487,211 +761,386 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
         }
     }
 
+    /**
+     * Drain all recent shards and move their nodes
+     * to the LRU head with a single sublist insertion.
+     */
     void pullRecent() {
-        NodeBase* current = popRecentListSlice();
+        NodeBase* head = pullHead();
+        NodeBase* tail = pullTail();
+        head->lru_next.store(link(tail), std::memory_order_relaxed);
+        tail->lru_prev.store(link(head), std::memory_order_relaxed);
+
+        for (size_t i = 0; i < recent_shard_count_; i++) {
+            pullRecentSlice(popRecentListSlice(recent_shards_[i]));
+        }
+
+        NodeBase* first = ptr(head->lru_next.load(std::memory_order_relaxed));
+        if (first == tail) {
+            // No recent nodes found
+            return;
+        }
 
-        NodeBase  head;
-        NodeBase* prev = &head;
+        addSublistToLruHead(first, ptr(tail->lru_prev.load(std::memory_order_relaxed)));
+    }
 
+    /**
+     * Unlink nodes of a recent slice from the LRU list
+     * and append them to the temporary list between pullHead() and pullTail().
+     * A node pulled from an earlier shard may be marked again and found in a later one,
+     * then it is moved within the temporary list, which is doubly linked for that reason.
+     *
+     * @param current first node of the slice
+     */
+    void pullRecentSlice(NodeBase* current) {
+        NodeBase* tail = pullTail();
         while (current != recentDummyTerminalPtr()) {
             // TODO memory order?
-            if (current->lru_prev == &lru_head_) {
+            if (ptr(current->lru_prev) == lruHead()) {
                 // skip this node
-                NodeBase* next = current->recent_next.load(std::memory_order_relaxed);
-                current->recent_next.store(nullptr, std::memory_order_relaxed);
+                NodeBase* next = ptr(current->recent_next.load(std::memory_order_relaxed));
+                current->recent_next.store(links_t::null(), std::memory_order_relaxed);
                 current = next;
             } else {
                 // extract node from LRU
                 removeNodeFromLru(current);
 
                 // add it to temp list
-                prev->lru_next.store(current, std::memory_order_relaxed);
-                current->lru_prev.store(prev, std::memory_order_relaxed);
-
-                prev    = current;
-                current = prev->recent_next.load(std::memory_order_relaxed);
-                prev->recent_next.store(nullptr, std::memory_order_relaxed);
+                link_t last = tail->lru_prev.load(std::memory_order_relaxed);
+                ptr(last)->lru_next.store(link(current), std::memory_order_relaxed);
+                current->lru_prev.store(last, std::memory_order_relaxed);
+                current->lru_next.store(link(tail), std::memory_order_relaxed);
+                tail->lru_prev.store(link(current), std::memory_order_relaxed);
+
+                NodeBase* next = ptr(current->recent_next.load(std::memory_order_relaxed));
+                current->recent_next.store(links_t::null(), std::memory_order_relaxed);
+                current = next;
             }
         }
-
-        if (prev == &head) {
-            // No recent nodes found
-            return;
-        }
-
-        addSublistToLruHead(head.lru_next.load(std::memory_order_relaxed), prev);
     }
 
+    /**
+     * Free at least required_nodes nodes from the LRU tail.
+     * Nodes are taken in whole tail segments, so a segment
+     * is unlinked from LRU list with a single update and each
+     * bucket lock is taken once per segment instead of once per node.
+     *
+     * @param required_nodes
+     */
     void purgeOld(size_t required_nodes) {
         size_t nodes_freed = 0;
-        size_t recent_seen = 0;
+        size_t nodes_seen  = 0;
 
         if (required_nodes == 0) {
             required_nodes = 1;
         }
 
-        NodeBase* node = lru_tail_.lru_prev.load(std::memory_order_relaxed);
+        while (nodes_freed < required_nodes && nodes_seen < this->max_element_count_) {
+            size_t segment_size = detachLruTailSegment(required_nodes - nodes_freed);
+            if (segment_size == 0) {
+                break;
+            }
+            nodes_seen += segment_size;
+            nodes_freed += purgeTailSegment();
+        }
+    }
 
-        // TODO remove check
-        while (node != &lru_head_ && nodes_freed < required_nodes) {
-            NodeBase* next = node->lru_prev.load(std::memory_order_acquire);
-            if (next == &lru_head_) {
+    /**
+     * Collect up to max_count nodes from LRU tail to purge_buffer_
+     * and unlink them from LRU list as a whole.
+     * LRU head neighbor is never taken, as it can be concurrently
+     * accessed by addSublistToLruHead.
+     *
+     * @param max_count
+     * @return number of detached nodes
+     */
+    size_t detachLruTailSegment(size_t max_count) {
+        purge_buffer_.clear();
+
+        NodeBase* node = ptr(lruTail()->lru_prev.load(std::memory_order_relaxed));
+        while (node != lruHead() && purge_buffer_.size() < max_count) {
+            NodeBase* prev = ptr(node->lru_prev.load(std::memory_order_acquire));
+            if (prev == lruHead()) {
                 break;
             }
 
-            if (!markedRecent(node)) {
-                Node* typed_node = reinterpret_cast<Node*>(node);
-                // Can fail if node was JUST marked recent
-                if (removeNodeFromBucket(typed_node, false)) {
-                    profile_stats_.evict++;
-                    removeNodeFromLru(typed_node);
+            Node* typed_node = static_cast<Node*>(node);
+            purge_buffer_.emplace_back(keyToBucketNr(payload(typed_node).key), typed_node);
+            node = prev;
+        }
 
-                    deleter_.onDelete(std::move(typed_node->key), std::move(typed_node->value));
-                    // this->current_element_count_--;
-                    disposeNode(node);
+        if (!purge_buffer_.empty()) {
+            // node is the new LRU tail neighbor
+            node->lru_next.store(link(lruTail()), std::memory_order_relaxed);
+            lruTail()->lru_prev.store(link(node), std::memory_order_relaxed);
+        }
 
-                    nodes_freed++;
+        return purge_buffer_.size();
+    }
+
+    /**
+     * Remove detached nodes in purge_buffer_ from buckets, taking each bucket lock once.
+     * Nodes that are marked recent are kept and returned to LRU head.
+     *
+     * @return number of freed nodes
+     */
+    size_t purgeTailSegment() {
+        std::sort(purge_buffer_.begin(), purge_buffer_.end(),
+                  [this](const auto& a, const auto& b) {
+                      return bucketLockNr(a.first) < bucketLockNr(b.first);
+                  });
+
+        // Kept and freed nodes are collected in two sublists by their first and last node
+        NodeBase* lru_first  = nullptr;
+        NodeBase* lru_last   = nullptr;
+        NodeBase* pool_first = nullptr;
+        NodeBase* pool_last  = nullptr;
+
+        size_t nodes_freed = 0;
+        size_t group_begin = 0;
+        while (group_begin < purge_buffer_.size()) {
+            size_t lock_nr   = bucketLockNr(purge_buffer_[group_begin].first);
+            size_t group_end = group_begin;
+
+            lockBucket(lock_nr);
+            for (; group_end < purge_buffer_.size() &&
+                   bucketLockNr(purge_buffer_[group_end].first) == lock_nr;
+                 group_end++) {
+                size_t bucket_nr = purge_buffer_[group_end].first;
+                Node*  node      = purge_buffer_[group_end].second;
+
+                // Node can be marked recent concurrently only under its (shared) bucket lock
+                if (markedRecent(node) || !unlinkNodeFromBucket(node, bucket_nr)) {
+                    if (lru_last) {
+                        lru_last->lru_next.store(link(node), std::memory_order_relaxed);
+                        node->lru_prev.store(link(lru_last), std::memory_order_relaxed);
+                    } else {
+                        lru_first = node;
+                    }
+                    lru_last = node;
                 } else {
-                    recent_seen++;
+                    profile_stats_.evict++;
+                    deleter_.onDelete(std::move(payload(node).key),
+                                      std::move(payload(node).value));
+                    // this->current_element_count_--;
+                    if (pool_last) {
+                        pool_last->empty_next.store(link(node), std::memory_order_relaxed);
+                    } else {
+                        pool_first = node;
+                    }
+                    pool_last = node;
+                    nodes_freed++;
                 }
-            } else {
-                recent_seen++;
             }
+            unlockBucket(lock_nr);
+
+            group_begin = group_end;
+        }
+
+        if (lru_first) {
+            addSublistToLruHead(lru_first, lru_last);
+        }
 
-            node = next;
+        if (pool_first) {
+            disposeSublist(pool_first, pool_last);
         }
+
+        return nodes_freed;
     }
 
     void addNodeToLruHead(NodeBase* node) { addSublistToLruHead(node, node); }
 
     void addSublistToLruHead(NodeBase* first, NodeBase* last) {
         profile_stats_.head_accesses++;
-        first->lru_prev.store(&lru_head_, std::memory_order_relaxed);
-        NodeBase* current_next = lru_head_.lru_next.load(std::memory_order_relaxed);
+        NodeBase* head = lruHead();
+        first->lru_prev.store(link(head), std::memory_order_relaxed);
+        link_t current_next = head->lru_next.load(std::memory_order_relaxed);
 
         do {
             last->lru_next.store(current_next, std::memory_order_relaxed);
-        } while (!lru_head_.lru_next.compare_exchange_weak(current_next, first));
+        } while (!head->lru_next.compare_exchange_weak(current_next, link(first)));
 
-        current_next->lru_prev.store(last, std::memory_order_release);
+        ptr(current_next)->lru_prev.store(link(last), std::memory_order_release);
     }
 
     void removeNodeFromLru(NodeBase* node) {
-        auto prev = node->lru_prev.load(std::memory_order_relaxed);
-        auto next = node->lru_next.load(std::memory_order_relaxed);
-        prev->lru_next.store(next, std::memory_order_relaxed);
-        next->lru_prev.store(prev, std::memory_order_relaxed);
+        link_t prev = node->lru_prev.load(std::memory_order_relaxed);
+        link_t next = node->lru_next.load(std::memory_order_relaxed);
+        ptr(prev)->lru_next.store(next, std::memory_order_relaxed);
+        ptr(next)->lru_prev.store(prev, std::memory_order_relaxed);
     }
 
     /**
+     * Bucket lock may be shared, so concurrent lookups claim the node
+     * by marking it with the terminal before pushing it to their shard.
      *
      * @param node expected to be locked
      */
-    void markNodeRecent(NodeBase* node) {
-        if (!markedRecent(node)) {
-            // memory fence after recent check
-            NodeBase* next = recent_head_.load(std::memory_order_acquire);
-            do {
-                node->recent_next.store(next, std::memory_order_relaxed);
-            } while (!recent_head_.compare_exchange_weak(next, node));
-
-            recent_count_++;
+    void markNodeRecent(NodeBase* node, RecentShard& shard) {
+        if (markedRecent(node) || !promotion_sampler_.promote()) {
+            return;
+        }
+        link_t unmarked = links_t::null();
+        if (!node->recent_next.compare_exchange_strong(unmarked, link(recentDummyTerminalPtr()))) {
+            return;
         }
+
+        link_t next = shard.head.load(std::memory_order_acquire);
+        do {
+            node->recent_next.store(next, std::memory_order_relaxed);
+        } while (!shard.head.compare_exchange_weak(next, link(node)));
+
+        shard.count.fetch_add(1, std::memory_order_relaxed);
     }
 
     bool markedRecent(NodeBase* node) {
-        return node->recent_next.load(std::memory_order_relaxed) != nullptr;
+        return node->recent_next.load(std::memory_order_relaxed) != links_t::null();
+    }
+
+    bool recentThresholdHit(const RecentShard& shard) {
+        return shard.count.load(std::memory_order_relaxed) >=
+               shard_pull_threshold_.load(std::memory_order_relaxed);
     }
 
-    bool recentThresholdHit() {
-        return recent_count_.load(std::memory_order_relaxed) >= pull_threshold_;
+    RecentShard& currentRecentShard() {
+        return recent_shards_[size_t(omp_get_thread_num()) % recent_shard_count_];
     }
 
-    NodeBase* popRecentListSlice() {
-        NodeBase* slice = recent_head_.exchange(recentDummyTerminalPtr());
-        recent_count_.store(0, std::memory_order_relaxed);
+    NodeBase* popRecentListSlice(RecentShard& shard) {
+        NodeBase* slice = ptr(shard.head.exchange(link(recentDummyTerminalPtr())));
+        shard.count.store(0, std::memory_order_relaxed);
         // Possible race condition is harmless
         return slice;
     }
 
     Node* allocateNode() {
         while (true) {
-            NodeBase* node = empty_head_.load(std::memory_order_acquire);
-            if (node == nullptr) {
-                requestPurge();
+            Node* node = popEmptyNode();
+            if (node) {
+                return node;
+            }
+            requestPurge();
+        }
+    }
+
+    /**
+     * Take a node from the pool.
+     * @return nullptr if the pool is empty
+     */
+    Node* popEmptyNode() {
+        while (true) {
+            link_t node = empty_head_.load(std::memory_order_acquire);
+            if (node == links_t::null()) {
+                return nullptr;
+            }
+            if (links_t::isMarked(node)) {
                 continue;
             }
 
-            if (ptrIsMarked(node) || !empty_head_.compare_exchange_weak(node, markPtr(node))) {
+            // Resolved before the CAS overwrites node, so the compiler sees it is not null
+            Node* first = nodeAt(node);
+            if (!empty_head_.compare_exchange_weak(node, links_t::mark(node))) {
                 continue;
             }
 
-            NodeBase* next       = node->empty_next.load(std::memory_order_relaxed);
-            NodeBase* markedNode = markPtr(node);
+            link_t next       = first->empty_next.load(std::memory_order_relaxed);
+            link_t markedNode = links_t::mark(node);
             if (!empty_head_.compare_exchange_weak(markedNode, next)) {
                 empty_head_.store(node, std::memory_order_relaxed);
                 continue;
             }
 
-            node->empty_next = nullptr;
-            return static_cast<Node*>(node);
+            first->empty_next.store(links_t::null(), std::memory_order_relaxed);
+            return first;
         }
     }
 
-    void disposeNode(NodeBase* node) {
+    void disposeNode(NodeBase* node) { disposeSublist(node, node); }
+
+    /**
+     * Atomically add a sublist linked with empty_next to the pool.
+     *
+     * @param first
+     * @param last
+     */
+    void disposeSublist(NodeBase* first, NodeBase* last) {
         while (true) {
-            NodeBase* next = empty_head_.load(std::memory_order_acquire);
-            if (ptrIsMarked(next)) {
+            link_t next = empty_head_.load(std::memory_order_acquire);
+            if (links_t::isMarked(next)) {
                 continue;
             }
-            node->empty_next.store(next, std::memory_order_relaxed);
-            if (empty_head_.compare_exchange_weak(next, node)) {
+            last->empty_next.store(next, std::memory_order_relaxed);
+            if (empty_head_.compare_exchange_weak(next, link(first))) {
                 break;
             }
         }
     }
 
     bool addNodeToBucket(Node* node) {
-        auto bucket_nr = keyToBucketNr(node->key);
-        lockBucket(bucket_nr);
-        BucketHead& head = buckets_[bucket_nr];
-
-        Node* next    = static_cast<Node*>(head.bucket_next);
-        Node* current = nullptr;
-
-        while (next && node->key >= next->key) {
-            if (node->key == next->key) {
-                unlockBucket(bucket_nr);
-                return false;
-            }
-            current = next;
-            next    = static_cast<Node*>(next->bucket_next);
-        }
-
-        if (current) {
-            current->bucket_next = node;
+        const key_t& key       = payload(node).key;
+        size_t       hash      = hasher_(key);
+        size_t       bucket_nr = lockHashBucket<false>(hash);
+
+        bool inserted = true;
+        if (UseSwissIndex) {
+            inserted = swiss_index_.insert(hash, nodeIndex(node), nodeKeyEq(key));
+        } else if (searchBucket(key, hash, bucket_nr)) {
+            inserted = false;
         } else {
-            head.bucket_next = node;
+            pushToBucket(buckets_[bucket_nr], node, hash);
         }
-        node->bucket_next = next;
 
         unlockBucket(bucket_nr);
-        return true;
+        return inserted;
+    }
+
+    /**
+     * @param bucket expected to be locked
+     * @param node
+     * @param hash hash of the node key
+     */
+    void pushToBucket(BucketBlock& bucket, Node* node, size_t hash) {
+        if (bucket.count < kBucketSlots) {
+            bucket.slots[bucket.count]        = nodeIndex(node);
+            bucket.fingerprints[bucket.count] = fingerprint(hash);
+            bucket.count++;
+        } else {
+            node->bucket_next = bucket.overflow;
+            bucket.overflow   = link(node);
+        }
     }
 
-    Node* searchBucket(const key_t& key, size_t bucket_nr) {
-        BucketHead& head = buckets_[bucket_nr];
+    /**
+     * @param key
+     * @param hash hash of the key
+     * @param bucket_nr expected to be locked
+     * @return
+     */
+    Node* searchBucket(const key_t& key, size_t hash, size_t bucket_nr) {
+        if (UseSwissIndex) {
+            uint32_t idx = swiss_index_.find(hash, nodeKeyEq(key));
+            return idx == swiss_t::npos ? nullptr : &nodes_[idx];
+        }
 
-        Node* node = head.bucket_next;
+        const BucketBlock& bucket = buckets_[bucket_nr];
+        uint8_t            fp     = fingerprint(hash);
 
-        while (node) {
-            if (key < node->key) {
-                break;
+        for (size_t slot = 0; slot < bucket.count; slot++) {
+            if (bucket.fingerprints[slot] != fp) {
+                continue;
+            }
+            Node* node = &nodes_[bucket.slots[slot]];
+            if (payload(node).key == key) {
+                return node;
             }
-            if (key == node->key) {
+        }
+
+        Node* node = nodeAt(bucket.overflow);
+        while (node) {
+            if (payload(node).key == key) {
                 return node;
             }
-            node = static_cast<Node*>(node->bucket_next);
+            node = nodeAt(node->bucket_next);
         }
 
         return nullptr;
@@ -703,91 +1152,440 @@ class DeferredLRU : public ContainerBase<Config, DeferredLRU<Config>, true> {
      * @return
      */
     bool removeNodeFromBucket(Node* node, bool remove_if_recent) {
-        auto bucket_nr = keyToBucketNr(node->key);
-        lockBucket(bucket_nr);
-        BucketHead& head = buckets_[bucket_nr];
+        size_t bucket_nr = lockHashBucket<false>(hasher_(payload(node).key));
 
         if (!remove_if_recent && markedRecent(node)) {
             unlockBucket(bucket_nr);
             return false;
         }
 
+        bool removed = unlinkNodeFromBucket(node, bucket_nr);
+
+        unlockBucket(bucket_nr);
+        return removed;
+    }
+
+    /**
+     * Can fail if node doesn't exist in bucket
+     * @param node
+     * @param bucket_nr expected to be locked
+     * @return
+     */
+    bool unlinkNodeFromBucket(Node* node, size_t bucket_nr) {
+        if (UseSwissIndex) {
+            return swiss_index_.erase(hasher_(payload(node).key), nodeIndex(node));
+        }
+
+        BucketBlock& bucket = buckets_[bucket_nr];
+        uint32_t     idx    = nodeIndex(node);
+
+        for (size_t slot = 0; slot < bucket.count; slot++) {
+            if (bucket.slots[slot] != idx) {
+                continue;
+            }
+
+            if (bucket.overflow != links_t::null()) {
+                // keep the block full while there are overflow nodes
+                Node* first               = nodeAt(bucket.overflow);
+                bucket.overflow           = first->bucket_next;
+                first->bucket_next        = links_t::null();
+                bucket.slots[slot]        = nodeIndex(first);
+                bucket.fingerprints[slot] = fingerprint(hasher_(payload(first).key));
+            } else {
+                bucket.count--;
+                bucket.slots[slot]        = bucket.slots[bucket.count];
+                bucket.fingerprints[slot] = bucket.fingerprints[bucket.count];
+            }
+            return true;
+        }
+
         Node* current = nullptr;
-        Node* next    = static_cast<Node*>(head.bucket_next);
+        Node* next    = nodeAt(bucket.overflow);
 
         while (next && node != next) {
             current = next;
-            next    = static_cast<Node*>(next->bucket_next);
+            next    = nodeAt(next->bucket_next);
         }
 
         if (node != next) {
-            unlockBucket(bucket_nr);
             return false;
         }
 
         if (current) {
             current->bucket_next = node->bucket_next;
         } else {
-            head.bucket_next = static_cast<Node*>(node->bucket_next);
+            bucket.overflow = node->bucket_next;
         }
+        node->bucket_next = links_t::null();
 
-        unlockBucket(bucket_nr);
         return true;
     }
 
-    NodeBase* recentDummyTerminalPtr() {
-        return reinterpret_cast<NodeBase*>(&recent_dummy_terminal_);
+    /**
+     * Bulk insert, see bulkLoad.
+     *
+     * @param count number of records
+     * @param threads
+     * @param fill fill(i, payload) copies record i
+     * @return number of inserted nodes
+     */
+    template <typename Fill>
+    size_t bulkBuild(size_t count, unsigned threads, const Fill& fill) {
+        threads = threads ? threads : unsigned(omp_get_max_threads());
+
+        std::vector<Node*> nodes;
+        nodes.reserve(std::min(count, this->max_element_count_));
+        while (nodes.size() < count) {
+            Node* node = popEmptyNode();
+            if (!node) {
+                break;
+            }
+            nodes.push_back(node);
+        }
+
+        std::vector<size_t> hashes(nodes.size());
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (size_t i = 0; i < nodes.size(); i++) {
+            fill(i, payload(nodes[i]));
+            hashes[i] = hasher_(payload(nodes[i]).key);
+        }
+
+        std::vector<uint8_t> inserted(nodes.size());
+        if (UseSwissIndex) {
+            // probe windows of neighbouring groups overlap, so they are still locked
+#pragma omp parallel for num_threads(threads) schedule(static)
+            for (size_t i = 0; i < nodes.size(); i++) {
+                inserted[i] = addNodeToBucket(nodes[i]);
+            }
+        } else {
+            BulkLoadPartition partition(nodes.size(), bucket_count_, threads,
+                                        [&](size_t i) { return hashToBucketNr(hashes[i]); });
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+            for (unsigned t = 0; t < partition.threads(); t++) {
+                for (const size_t* i = partition.begin(t); i != partition.end(t); i++) {
+                    Node*        node      = nodes[*i];
+                    size_t       bucket_nr = hashToBucketNr(hashes[*i]);
+                    const key_t& key       = payload(node).key;
+                    if (!searchBucket(key, hashes[*i], bucket_nr)) {
+                        pushToBucket(buckets_[bucket_nr], node, hashes[*i]);
+                        inserted[*i] = true;
+                    }
+                }
+            }
+        }
+
+        size_t loaded = 0;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (inserted[i]) {
+                nodes[loaded++] = nodes[i];
+            } else {
+                deleter_.onDelete(std::move(payload(nodes[i]).key),
+                                  std::move(payload(nodes[i]).value));
+                disposeNode(nodes[i]);
+            }
+        }
+        if (loaded == 0) {
+            return 0;
+        }
+
+        NodeBase* old_first = ptr(lruHead()->lru_next.load(std::memory_order_relaxed));
+#pragma omp parallel for num_threads(threads) schedule(static)
+        for (size_t i = 0; i < loaded; i++) {
+            nodes[i]->lru_prev.store(link(i ? nodes[i - 1] : lruHead()), std::memory_order_relaxed);
+            nodes[i]->lru_next.store(link(i + 1 < loaded ? nodes[i + 1] : old_first),
+                                     std::memory_order_relaxed);
+        }
+        old_first->lru_prev.store(link(nodes[loaded - 1]), std::memory_order_relaxed);
+        lruHead()->lru_next.store(link(nodes[0]), std::memory_order_release);
+        return loaded;
+    }
+
+    /**
+     * One step of resize, expects the LRU lock to be held.
+     *
+     * @param count target capacity
+     * @param constructed number of constructed data nodes
+     * @return true if the capacity and the table reached the target
+     */
+    bool resizeStep(size_t count, size_t constructed) {
+        if (count > this->max_element_count_) {
+            // retired nodes come back first
+            size_t reused =
+                std::min({retired_count_, count - this->max_element_count_, kResizeStep});
+            if (reused) {
+                NodeBase* first = ptr(retired_head_);
+                NodeBase* last  = first;
+                for (size_t i = 1; i < reused; i++) {
+                    last = ptr(last->empty_next.load(std::memory_order_relaxed));
+                }
+                retired_head_ = last->empty_next.load(std::memory_order_relaxed);
+                retired_count_ -= reused;
+                disposeSublist(first, last);
+            }
+
+            if (constructed > node_count_) {
+                for (size_t i = node_count_; i < constructed - 1; i++) {
+                    dataNode(i)->empty_next.store(link(dataNode(i + 1)),
+                                                  std::memory_order_relaxed);
+                }
+                disposeSublist(dataNode(node_count_), dataNode(constructed - 1));
+                node_count_ = constructed;
+            }
+        } else if (count < this->max_element_count_) {
+            pullRecent();
+            size_t excess = std::min(this->max_element_count_ - count, kResizeStep);
+            for (size_t i = 0; i < excess; i++) {
+                Node* node = popEmptyNode();
+                if (!node) {
+                    purgeOld(excess - i);
+                    node = popEmptyNode();
+                }
+                if (!node) {
+                    // taken by concurrent inserts, the next step purges again
+                    break;
+                }
+                node->empty_next.store(retired_head_, std::memory_order_relaxed);
+                retired_head_ = link(node);
+                retired_count_++;
+            }
+        }
+        this->max_element_count_   = node_count_ - retired_count_;
+        this->total_mem_available_ = memSizeForElements(this->max_element_count_);
+        updateThresholds();
+
+        size_t target_buckets = 0;
+        if (!UseSwissIndex) {
+            target_buckets = std::min(
+                buckets_.capacity(),
+                size_t(std::ceil(this->max_element_count_ / config::hashTableLoadFactor())));
+            for (size_t i = 0; i < kResizeSplits && bucket_count_ < target_buckets; i++) {
+                splitBucket();
+            }
+        }
+
+        return this->max_element_count_ == count && bucket_count_ >= target_buckets;
+    }
+
+    /**
+     * Add a bucket to the table and move over the nodes of the bucket it splits.
+     * The new count is published under the lock of the split bucket,
+     * so threads waiting for it see that their bucket could have changed.
+     */
+    void splitBucket() {
+        size_t count = bucket_count_.load(std::memory_order_relaxed);
+        size_t split = count - roundDownToPowerOfTwo(count);
+        if (count == buckets_.size()) {
+            buckets_.grow(std::min(buckets_.capacity(), count + kResizeSplits));
+        }
+
+        lockBucket(split);
+        BucketBlock& bucket = buckets_[split];
+        split_buffer_.clear();
+        for (size_t slot = 0; slot < bucket.count; slot++) {
+            split_buffer_.push_back(&nodes_[bucket.slots[slot]]);
+        }
+        Node* node = nodeAt(bucket.overflow);
+        while (node) {
+            split_buffer_.push_back(node);
+            Node* next        = nodeAt(node->bucket_next);
+            node->bucket_next = links_t::null();
+            node              = next;
+        }
+        bucket.count    = 0;
+        bucket.overflow = links_t::null();
+
+        for (Node* moved : split_buffer_) {
+            size_t hash = hasher_(payload(moved).key);
+            pushToBucket(buckets_[linearHashBucket(hash, count + 1)], moved, hash);
+        }
+        bucket_count_.store(count + 1, std::memory_order_release);
+        unlockBucket(split);
     }
 
-    size_t keyToBucketNr(const key_t& key) {
-        // TODO: mask operation
-        return hasher_(key) % buckets_.size();
+    void updateThresholds() {
+        pull_threshold_ = std::max<size_t>(
+            size_t(pull_threshold_factor_ * this->max_element_count_), 1);
+        purge_threshold_ = std::max<size_t>(
+            size_t(purge_threshold_factor_ * this->max_element_count_), 1);
+        // pull is requested as soon as any shard collects its share of the threshold
+        shard_pull_threshold_.store(std::max<size_t>(pull_threshold_ / recent_shard_count_, 1),
+                                    std::memory_order_relaxed);
     }
 
-    void lockBucket(size_t bucket_nr) { bucket_locks_[bucket_nr & bucketLockIndexMask()].lock(); }
+    static constexpr size_t sentinelNodeCount() { return 3 * sentinelStride<Node>() + 2; }
+
+    NodeBase* lruHead() const { return &nodes_[0]; }
+
+    NodeBase* lruTail() const { return &nodes_[sentinelStride<Node>()]; }
+
+    NodeBase* recentDummyTerminalPtr() const { return &nodes_[2 * sentinelStride<Node>()]; }
+
+    /// Head and tail of the list collected by pullRecent(), used under the LRU lock only
+    NodeBase* pullHead() const { return &nodes_[3 * sentinelStride<Node>()]; }
+
+    NodeBase* pullTail() const { return &nodes_[3 * sentinelStride<Node>() + 1]; }
+
+    /// Data nodes follow the sentinels
+    Node* dataNode(size_t i) const { return &nodes_[sentinelNodeCount() + i]; }
+
+    NodeBase* ptr(link_t l) const { return links_.toNode(l); }
+
+    Node* nodeAt(link_t l) const { return static_cast<Node*>(ptr(l)); }
+
+    link_t link(NodeBase* node) const { return links_.toLink(node); }
+
+    size_t keyToBucketNr(const key_t& key) { return hashToBucketNr(hasher_(key)); }
+
+    /// With SwissIndex a bucket is the probe window of a home group
+    size_t hashToBucketNr(size_t hash) const {
+        if (UseSwissIndex) {
+            return swiss_index_.homeGroup(hash);
+        }
+        return linearHashBucket(hash, bucket_count_.load(std::memory_order_acquire));
+    }
+
+    /// Buckets with the same lock number are protected by the same lock
+    size_t bucketLockNr(size_t bucket_nr) const { return bucket_nr; }
+
+    void lockBucket(size_t bucket_nr) {
+        if (UseSwissIndex) {
+            swiss_index_.lockWindow(bucket_nr, [this, bucket_nr](lock_t& lock) {
+                lock_profiler_.lock(LockClass::Bucket, lock, bucket_nr);
+            });
+        } else {
+            lock_profiler_.lock(LockClass::Bucket, buckets_[bucket_nr].lock, bucket_nr);
+        }
+    }
 
     void unlockBucket(size_t bucket_nr) {
-        bucket_locks_[bucket_nr & bucketLockIndexMask()].unlock();
+        if (UseSwissIndex) {
+            swiss_index_.unlockWindow(bucket_nr);
+        } else {
+            buckets_[bucket_nr].lock.unlock();
+        }
+    }
+
+    /**
+     * Lock the bucket of the hash.
+     * A concurrent resize can split the bucket before the lock is taken,
+     * so the bucket number is looked up again under the lock.
+     *
+     * @tparam Shared lock in shared mode, see lockBucketShared
+     * @param hash
+     * @return number of the locked bucket
+     */
+    template <bool Shared>
+    size_t lockHashBucket(size_t hash) {
+        size_t bucket_nr = hashToBucketNr(hash);
+        while (true) {
+            Shared ? lockBucketShared(bucket_nr) : lockBucket(bucket_nr);
+            size_t current = hashToBucketNr(hash);
+            if (current == bucket_nr) {
+                return bucket_nr;
+            }
+            Shared ? unlockBucketShared(bucket_nr) : unlockBucket(bucket_nr);
+            lock_profiler_.retry(LockClass::Bucket);
+            bucket_nr = current;
+        }
     }
 
-    std::unique_ptr<Node[]>   nodes_;
-    std::vector<BucketHead>   buckets_;
-    std::unique_ptr<lock_t[]> bucket_locks_;
+    /// Lookups lock the bucket in shared mode if the lock has one
+    void lockBucketShared(size_t bucket_nr) {
+        if constexpr (SupportsSharedLock<lock_t>::value) {
+            if (UseSwissIndex) {
+                swiss_index_.lockWindow(bucket_nr, [this, bucket_nr](lock_t& lock) {
+                    lock_profiler_.lockShared(LockClass::Bucket, lock, bucket_nr);
+                });
+            } else {
+                lock_profiler_.lockShared(LockClass::Bucket, buckets_[bucket_nr].lock, bucket_nr);
+            }
+        } else {
+            lockBucket(bucket_nr);
+        }
+    }
 
-    typename config::hasher_t        hasher_;
-    typename config::deletion_policy deleter_;
-    typename config::profile_stats_t profile_stats_;
+    void unlockBucketShared(size_t bucket_nr) {
+        if constexpr (SupportsSharedLock<lock_t>::value) {
+            if (UseSwissIndex) {
+                swiss_index_.unlockWindow(bucket_nr, [](lock_t& lock) { lock.unlock_shared(); });
+            } else {
+                buckets_[bucket_nr].lock.unlock_shared();
+            }
+        } else {
+            unlockBucket(bucket_nr);
+        }
+    }
 
-    size_t pull_threshold_;
-    size_t purge_threshold_;
+    uint32_t nodeIndex(const Node* node) const { return uint32_t(node - &nodes_[0]); }
 
-    std::map<void*, const char*> named_nodes_; // For debugging only
-    bool                         recent_dummy_terminal_;
+    auto nodeKeyEq(const key_t& key) const {
+        return [this, &key](uint32_t idx) { return payload(&nodes_[idx]).key == key; };
+    }
 
-    CACHELINE_ALIGN NodeBase lru_head_;
-    CACHELINE_ALIGN NodeBase lru_tail_;
+    static constexpr size_t nodeSize() {
+        return sizeof(Node) + (SplitPayload ? sizeof(Payload) : 0);
+    }
+
+    Payload& payload(Node* node) const {
+        if constexpr (SplitPayload) {
+            return payloads_[nodeIndex(node) - sentinelNodeCount()];
+        } else {
+            return *node;
+        }
+    }
+
+    NodeArray<Node>        nodes_;
+    NodeArray<Payload>     payloads_;
+    links_t                links_;
+    NodeArray<BucketBlock> buckets_;
+    std::atomic<size_t>    bucket_count_{0}; ///< buckets in use, grows by linear hashing
+    swiss_t                swiss_index_;
+
+    size_t node_count_    = 0;               ///< constructed data nodes, including retired ones
+    link_t retired_head_  = links_t::null(); ///< nodes taken out of the pool by resize
+    size_t retired_count_ = 0;
+
+    std::unique_ptr<RecentShard[]> recent_shards_;
+    size_t                         recent_shard_count_ = 0;
+
+    // Detached LRU tail segment, accessed only under lru_lock_
+    std::vector<std::pair<size_t, Node*>> purge_buffer_;
+
+    // Nodes of a bucket that is being split, accessed only under lru_lock_
+    std::vector<Node*> split_buffer_;
 
-    CACHELINE_ALIGN atomic_t<NodeBase*> empty_head_;
+    typename config::index_hasher_t      hasher_;
+    typename config::deletion_policy     deleter_;
+    typename config::profile_stats_t     profile_stats_;
+    typename config::lock_profiler_t     lock_profiler_;
+    typename config::promotion_sampler_t promotion_sampler_;
 
-    CACHELINE_ALIGN atomic_t<NodeBase*> recent_head_;
-    CACHELINE_ALIGN atomic_t<size_t> recent_count_;
+    double              pull_threshold_factor_;
+    double              purge_threshold_factor_;
+    size_t              pull_threshold_;
+    std::atomic<size_t> shard_pull_threshold_;
+    size_t              purge_threshold_;
+
+    std::map<void*, const char*> named_nodes_; // For debugging only
+
+    CACHELINE_ALIGN atomic_t<link_t> empty_head_;
 
     CACHELINE_ALIGN std::atomic<bool> pull_request_;
     CACHELINE_ALIGN std::atomic<bool> purge_request_;
     CACHELINE_ALIGN std::mutex lru_lock_; // TODO use typedef from config
 };
 
-template <typename Config>
-void DeferredLRU<Config>::dump(const char* msg) {
+template <typename Config, bool UseSwissIndex, typename NodeIndexT, bool SplitPayload>
+void DeferredLRU<Config, UseSwissIndex, NodeIndexT, SplitPayload>::dump(const char* msg) {
     std::cout << "DeferredLRU dump: " << (msg ? msg : "") << "\nLRU:    ";
     size_t lru_total_count  = 0;
     size_t lru_recent_count = 0;
 
-    NodeBase* current = &lru_head_;
+    NodeBase* current = lruHead();
     while (current) {
-        if (current != &lru_head_) {
+        if (current != lruHead()) {
             std::cout << " :: ";
-            if (current != &lru_tail_) {
+            if (current != lruTail()) {
                 lru_total_count++;
                 if (markedRecent(current)) {
                     lru_recent_count++;
@@ -795,43 +1593,49 @@ void DeferredLRU<Config>::dump(const char* msg) {
             }
         }
         std::cout << ptrName(current);
-        current = current->lru_next;
+        current = ptr(current->lru_next);
     }
-    size_t recent_count = 0;
-    std::cout << "\nRECENT: ";
-    current = recent_head_;
-    while (current) {
-        std::cout << " :> " << ptrName(current);
-        if (current == recentDummyTerminalPtr()) {
-            break;
-        } else {
-            recent_count++;
-            current = current->recent_next;
+    size_t recent_count          = 0;
+    size_t recent_expected_count = 0;
+    for (size_t i = 0; i < recent_shard_count_; i++) {
+        std::cout << "\nRECENT[" << i << "]: ";
+        recent_expected_count += recent_shards_[i].count;
+        current = ptr(recent_shards_[i].head);
+        while (current) {
+            std::cout << " :> " << ptrName(current);
+            if (current == recentDummyTerminalPtr()) {
+                break;
+            } else {
+                recent_count++;
+                current = ptr(current->recent_next);
+            }
         }
     }
     std::cout << "\nEMPTY:  ";
-    current = empty_head_;
+    current = ptr(empty_head_);
     while (current) {
         std::cout << " :> " << ptrName(current);
-        current = current->lru_next;
+        current = ptr(current->empty_next);
     }
     std::cout << "\n";
 
-    std::cout << "expected count: " << this->current_element_count_ << '(' << this->recent_count_
+    std::cout << "expected count: " << this->current_element_count_ << '(' << recent_expected_count
               << "*)\n"
               << "lru count:      " << lru_total_count << '(' << lru_recent_count << "*)\n"
               << "recent count:    (" << recent_count << "*)\n\n"
               << std::endl;
 }
 
-template <typename Config>
-const char* DeferredLRU<Config>::ptrName(void* ptr, char* ext_buf) {
+template <typename Config, bool UseSwissIndex, typename NodeIndexT, bool SplitPayload>
+const char* DeferredLRU<Config, UseSwissIndex, NodeIndexT, SplitPayload>::ptrName(void* ptr,
+                                                                                 char* ext_buf) {
     if (named_nodes_.empty()) {
-        named_nodes_.insert({{&lru_head_, "lru_head"},
-                             {&lru_tail_, "lru_tail"},
+        named_nodes_.insert({{lruHead(), "lru_head"},
+                             {lruTail(), "lru_tail"},
                              {&empty_head_, "pool_head"},
-                             {&recent_head_, "recent_head"},
                              {recentDummyTerminalPtr(), "<TERMINAL>"},
+                             {pullHead(), "pull_head"},
+                             {pullTail(), "pull_tail"},
                              {nullptr, "NULL"}});
     }
     static thread_local char buf[1000];
@@ -842,18 +1646,18 @@ const char* DeferredLRU<Config>::ptrName(void* ptr, char* ext_buf) {
     if (named_nodes_.count(ptr)) {
         return named_nodes_[ptr];
     }
-    if (ptr >= &nodes_[0] && ptr <= &nodes_[this->max_element_count_ - 1]) {
+    if (node_count_ && ptr >= dataNode(0) && ptr <= dataNode(node_count_ - 1)) {
         bool is_recent = markedRecent((Node*)ptr);
         if (std::is_same<key_t, int>::value) {
-            sprintf(ext_buf, "#%lu<%lu>%c", (Node*)ptr - &nodes_[0], ((Node*)ptr)->key,
+            sprintf(ext_buf, "#%lu<%lu>%c", (Node*)ptr - &nodes_[0], payload((Node*)ptr).key,
                     is_recent ? '*' : '\0');
         } else {
             sprintf(ext_buf, "#%lu%c", (Node*)ptr - &nodes_[0], is_recent ? '*' : '\0');
         }
         return ext_buf;
     }
-    if (ptr >= &buckets_.front() && ptr <= &buckets_.back()) {
-        sprintf(ext_buf, "Bucket[%lu]", (BucketHead*)ptr - &buckets_.front());
+    if (bucket_count_ && ptr >= &buckets_[0] && ptr <= &buckets_[bucket_count_ - 1]) {
+        sprintf(ext_buf, "Bucket[%lu]", (BucketBlock*)ptr - &buckets_[0]);
         return ext_buf;
     }
     sprintf(ext_buf, "???[%p]", ptr);
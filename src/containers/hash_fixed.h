@@ -35,7 +35,8 @@
  * constructor. But that can be hacked to construct them by copy.
  *
  * The HashFixed can not be resized and the number of bucket is the
- * maximum number of element in the HashMap. There is no use of
+ * smallest power of two that keeps the load factor within
+ * Config::hashTableLoadFactor(). There is no use of
  * pointers internally, but indexing in the storage array with 32-bit
  * integers. If a HashFixed larger than 2**32 elements is required,
  * the data structure will need to be adapted (most likely just
@@ -104,7 +105,8 @@ class HashFixed : public ContainerBase<Config, HashFixed<Config>, true> {
     void allocateMemory(size_t capacity, bool is_item_capacity) {
         this->init(capacity, is_item_capacity);
 
-        bucket_count_ = size_t(this->max_element_count_ / load_factor);
+        bucket_count_ = bucketCountForLoadFactor(this->max_element_count_, load_factor);
+        bucket_mask_  = bucket_count_ - 1;
 
         storage_ = new Element[this->max_element_count_];
         bucket_  = new std::atomic<index_t>[bucket_count_];
@@ -212,14 +214,15 @@ class HashFixed : public ContainerBase<Config, HashFixed<Config>, true> {
     }
 
     /// chose which bucket a key is affected to.
-    int whichBucket(const key_t& k) const { return hasher_(k) % bucket_count_; }
+    int whichBucket(const key_t& k) const { return hasher_(k) & bucket_mask_; }
 
     std::atomic<index_t>* bucket_; // give head of bucket
     Element*              storage_;
 
     size_t bucket_count_;
+    size_t bucket_mask_;
 
-    typename config::hasher_t        hasher_;
+    typename config::index_hasher_t  hasher_;
     typename config::deletion_policy deletion_policy_;
     typename config::profile_stats_t profile_stats_;
 };
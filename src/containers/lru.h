@@ -1,13 +1,19 @@
 #ifndef LRU_CACHE_H
 #define LRU_CACHE_H
 
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <memory>
 #include <mutex>
 
 #include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
 
 #include "containers/container_base.h"
+#include "containers/node_array.h"
+#include "containers/snapshot.h"
+#include "containers/swiss_index.h"
 #include "utility.h"
 
 /**
@@ -39,14 +45,36 @@
  * The Hasher and the Policy are constructed using the default
  * constructor. But that can be hacked to construct them by copy.
  *
- * The cache can not be resized and the number of bucket is the
- * maximum number of element in the cache. There is no use of pointers
+ * The initial number of buckets is the smallest power of two that keeps
+ * the load factor within Config::hashTableLoadFactor(). resize() changes
+ * the capacity while the cache is in use: storage arrays are reserved for
+ * NodePlacement::max_growth times the capacity and grow in place, and the table
+ * grows by linear hashing, one bucket split at a time. There is no use of pointers
  * internally, but indexing in the storage array with 32-bit
  * integers. If a cache larger than 2**32 elements is required, the
  * data structure will need to be adapted (most like just changing the
  * type of index). If a cache smaller than 2**16 elements is useful,
  * the index could be changed to 16-bit integers to gain space.
  *
+ * With UseSwissIndex the bucket lists are replaced by an open addressing
+ * SwissIndex over the storage array, bucket links of elements are unused then.
+ *
+ * With SplitPayload the storage is split into two arrays indexed by element
+ * number: list/bucket links (16 bytes, four per cache line) and key/value pairs.
+ * List updates and eviction then do not pull payload cache lines and
+ * bucket walks touch a payload only to compare the key.
+ *
+ * ListSync selects how concurrent operations get to the list (see LruListSync).
+ * With flat combining a thread publishes its find or insert in its own slot,
+ * whichever thread gets the lock applies all published operations in one batch,
+ * so the list and the table stay in the cache of the combiner and the lock
+ * changes hands once per batch instead of once per operation.
+ * With read buffers a hit looks the key up under the shared mode of the lock,
+ * so the lock type must have one (e.g. RWSpinLock, BravoRWLock), and only records
+ * the element in a small per-thread ring, which is drained into the list by whoever
+ * gets the lock with try_lock or by the next insert. A full ring drops hits,
+ * so the order is approximate, much like the deferred promotion of DeferredLRU.
+ *
  * If the cache is believed to have bugs, turn on the DEBUG template
  * parameter and active assertions. That might not cache all the bugs,
  * but should catch some.
@@ -64,24 +92,79 @@ Policy = no_eviction_policy<Key,Value>, typename Locking = no_locking, bool DEBU
 PROFILE=false> #endif
 **/
 
-template <typename Config, unsigned int IgnoreBitsInHash = 0>
-class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>, false> {
+enum class LruListSync {
+    Lock,          ///< every operation takes the cache lock
+    FlatCombining, ///< operations are published and applied in batches by the lock holder
+    ReadBuffer     ///< hits are recorded in lossy per-thread buffers, applied in batches,
+                   ///< lookups take the lock in shared mode, so it must have one
+};
+
+template <typename Config, unsigned int IgnoreBitsInHash = 0, bool UseSwissIndex = false,
+          bool SplitPayload = false, LruListSync ListSync = LruListSync::Lock>
+class LRUCache
+    : public ContainerBase<
+          Config, LRUCache<Config, IgnoreBitsInHash, UseSwissIndex, SplitPayload, ListSync>,
+          false> {
     using config  = Config;
     using key_t   = typename config::key_t;
     using value_t = typename config::value_t;
     using index_t = int;
+    using swiss_t = SwissIndex<index_t>;
+
+    static constexpr bool kFlatCombining = ListSync == LruListSync::FlatCombining;
+    static constexpr bool kReadBuffer    = ListSync == LruListSync::ReadBuffer;
 
-    struct Element {
-        index_t list_prev;   //-1 => head of list
+    static_assert(!kReadBuffer || SupportsSharedLock<typename config::locking_t>::value,
+                  "LruListSync::ReadBuffer needs a lock with a shared mode, e.g. BravoRWLock");
+
+    struct Links {
+        index_t list_prev;   //-1 => head of list, kFreeElement => in the empty list
         index_t list_next;   //-1 => tail of list
         index_t bucket_prev; //-x => head of bucket (x-1)
         index_t bucket_next; //-1 => tail of bucket
+    };
+
+    struct Item {
         key_t   key;
         value_t value;
     };
 
+    struct Element : Links, Item {};
+
+    /// Operation published for the combiner, written by its thread while not pending
+    struct CACHELINE_ALIGN CombiningSlot {
+        std::atomic<bool> pending{false};
+        bool              is_insert;
+        bool              found;
+        const key_t*      key;
+        const value_t*    value;
+        value_t           result;
+    };
+
+    /// Hits of one thread not yet applied to the list, only drained is written by other threads
+    struct CACHELINE_ALIGN ReadBuffer {
+        static constexpr size_t kSize = 16;
+
+        std::atomic<size_t>                     written{0};
+        std::atomic<size_t>                     drained{0};
+        std::array<std::atomic<index_t>, kSize> elements;
+    };
+
+    static constexpr index_t kFreeElement = -2;
+
+    /// Threads with a larger slot id take the lock themselves
+    static constexpr size_t kThreadSlots          = 128;
+    static constexpr int    kCombiningPasses      = 3;
+    static constexpr size_t kReadBufferDrainLevel = ReadBuffer::kSize / 2;
+
+    /// Elements added or evicted and buckets split by resize() per lock acquisition
+    static constexpr size_t kResizeStep   = 1024;
+    static constexpr size_t kResizeSplits = 256;
+
   public:
-    LRUCache(size_t capacity = 0, bool is_item_capacity = false) {
+    LRUCache(size_t capacity = 0, bool is_item_capacity = false)
+        : combining_slots_(kFlatCombining ? new CombiningSlot[kThreadSlots] : nullptr),
+          read_buffers_(kReadBuffer ? new ReadBuffer[kThreadSlots] : nullptr) {
         /// initialize a cache that stores size objects. Subsequently added object will cause an
         /// eviction.
         allocateMemory(capacity, is_item_capacity);
@@ -89,17 +172,36 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
 
     ~LRUCache() { releaseMemory(); }
 
-    static const char* name() { return "LRU"; }
+    static const char* name() {
+        if (kFlatCombining) {
+            return "LRU_FC";
+        }
+        if (kReadBuffer) {
+            return "LRU_RB";
+        }
+        if (SplitPayload) {
+            return "LRU_SoA";
+        }
+        return UseSwissIndex ? "LRU_Swiss" : "LRU";
+    }
 
     decltype(auto) profileStats() const { return profile_stats_.getSlice(); }
 
+    LockProfileReport lockProfile() const { return lock_profiler_.report(); }
+
     size_t currentOverheadMemory() const {
-        return sizeof(index_t) * bucket_count_ +
-               (sizeof(Element) - sizeof(key_t) - sizeof(value_t)) * this->current_element_count_;
+        return sizeof(index_t) * bucket_count_ + swiss_index_.memoryUsage() +
+               (elementStorageSize() - sizeof(key_t) - sizeof(value_t)) *
+                   this->current_element_count_ +
+               (kFlatCombining ? sizeof(CombiningSlot) * kThreadSlots : 0) +
+               (kReadBuffer ? sizeof(ReadBuffer) * kThreadSlots : 0);
     }
 
     static double elementSize() {
-        return sizeof(Element) + sizeof(index_t) / config::hashTableLoadFactor();
+        if (UseSwissIndex) {
+            return elementStorageSize() + swiss_t::bytesPerElement();
+        }
+        return elementStorageSize() + sizeof(index_t) / config::hashTableLoadFactor();
     }
 
     void allocateMemory(size_t capacity, bool is_item_capacity) {
@@ -108,23 +210,39 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
             return;
         }
 
-        bucket_count_ = size_t(this->max_element_count_ / config::hashTableLoadFactor());
-        storage_      = new Element[this->max_element_count_];
-        if (bucket_count_ < 4) {
-            throw std::runtime_error("Too small capacity");
+        size_t reserve = NodePlacement::global().reserveCount(this->max_element_count_);
+        if (UseSwissIndex) {
+            bucket_count_ = 0;
+            swiss_index_.allocate(reserve);
+        } else {
+            bucket_count_ =
+                bucketCountForLoadFactor(this->max_element_count_, config::hashTableLoadFactor());
+            if (bucket_count_ < 4) {
+                throw std::runtime_error("Too small capacity");
+            }
         }
+        if (SplitPayload) {
+            links_storage_.reserve(this->max_element_count_, reserve);
+            items_storage_.reserve(this->max_element_count_, reserve);
+        } else {
+            storage_.reserve(this->max_element_count_, reserve);
+        }
+        element_count_ = this->max_element_count_;
 
         // init "empty" linked list
         lru_list_head_ = -1;
         lru_list_tail_ = -1;
 
-        for (index_t i = 0; i < this->max_element_count_ - 1; i++) {
-            storage_[i].list_next = i + 1;
+        for (index_t i = 0; i < this->max_element_count_; i++) {
+            links(i).list_prev = kFreeElement;
+            links(i).list_next = i + 1;
         }
-        storage_[this->max_element_count_ - 1].list_next = -1;
-        empty_nodes_head_                                = 0;
+        links(this->max_element_count_ - 1).list_next = -1;
+        empty_nodes_head_                             = 0;
 
-        bucket_ = new index_t[bucket_count_];
+        size_t bucket_reserve =
+            UseSwissIndex ? 0 : bucketCountForLoadFactor(reserve, config::hashTableLoadFactor());
+        bucket_.reserve(bucket_count_, bucket_reserve);
         for (int i = 0; i < bucket_count_; i++) {
             bucket_[i] = -1;
         }
@@ -135,19 +253,126 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
         }
     }
 
+    /**
+     * Changes the capacity while the cache is in use.
+     * Growing constructs elements in the reserve of the storage arrays
+     * (see NodePlacement::max_growth) and splits buckets to keep the load factor,
+     * shrinking evicts least recently used elements, their storage is kept for regrowth.
+     * Work is done in steps of kResizeStep elements and the lock is released
+     * between them, so lookups and inserts go on. Only one resize may run at a time.
+     */
+    void resize(size_t capacity, bool is_item_capacity = true) {
+        size_t count = is_item_capacity ? capacity : this->maxElementCountForCapacity(capacity);
+        if (count == 0) {
+            throw std::runtime_error("Too small capacity");
+        }
+        if (count > elementReserve()) {
+            throw std::runtime_error("Capacity exceeds the reserve, see NodePlacement::max_growth");
+        }
+
+        bool done = false;
+        while (!done) {
+            // only resize links new elements, so they are constructed without the lock
+            size_t constructed = std::min(element_count_ + kResizeStep, count);
+            if (constructed > element_count_) {
+                growStorage(constructed);
+            }
+
+            lock_profiler_.lock(LockClass::Global, lock_);
+            typename config::lock_guard_t lg(lock_, std::adopt_lock);
+            done = resizeStep(count, constructed);
+        }
+    }
+
+    /**
+     * Writes the elements to a snapshot file from the most to the least recently used one.
+     * The cache stays locked while the list is written out.
+     * @return number of written elements
+     */
+    size_t saveSnapshot(const std::string& path) {
+        SnapshotWriter<key_t, value_t> writer(path);
+        {
+            lock_profiler_.lock(LockClass::Global, lock_);
+            typename config::lock_guard_t lg(lock_, std::adopt_lock);
+            if (kReadBuffer) {
+                drainReadBuffers();
+            }
+            for (index_t i = lru_list_tail_; i != -1; i = links(i).list_prev) {
+                writer.write(item(i).key, item(i).value);
+            }
+        }
+        return writer.finish();
+    }
+
+    /**
+     * Fills an empty cache from a snapshot file in a single pass.
+     * Element i takes record i and the list and the table are linked directly,
+     * so nothing is locked and no other thread may use the cache meanwhile.
+     * Records beyond the capacity are the least recently used ones and are skipped.
+     * @return number of loaded elements
+     */
+    size_t loadSnapshot(const std::string& path) {
+        if (lru_list_head_ != -1) {
+            throw std::runtime_error("Snapshot can only be loaded into an empty cache");
+        }
+        SnapshotReader<key_t, value_t> reader(path);
+
+        size_t  count  = std::min(reader.size(), this->max_element_count_);
+        index_t loaded = 0;
+        for (const auto& record : reader) {
+            if (size_t(loaded) == count) {
+                break;
+            }
+            item(loaded).key   = record.key;
+            item(loaded).value = record.value;
+            if (UseSwissIndex) {
+                if (!swiss_index_.insert(swissHash(record.key), loaded, keyEq(record.key))) {
+                    continue;
+                }
+            } else {
+                pushToBucket(loaded, whichBucket(record.key));
+            }
+            // the list runs from the least recently used element at the head
+            links(loaded).list_next = loaded - 1;
+            links(loaded).list_prev = loaded + 1;
+            loaded++;
+        }
+
+        lru_list_tail_ = loaded ? 0 : -1;
+        lru_list_head_ = loaded - 1;
+        if (loaded) {
+            links(loaded - 1).list_prev = -1;
+        }
+        for (size_t i = loaded; i < element_count_; i++) {
+            links(index_t(i)).list_prev = kFreeElement;
+            links(index_t(i)).list_next = index_t(i + 1);
+        }
+        empty_nodes_head_ = size_t(loaded) < element_count_ ? loaded : -1;
+        if (empty_nodes_head_ != -1) {
+            links(index_t(element_count_ - 1)).list_next = -1;
+        }
+        this->current_element_count_ = loaded;
+
+        if (config::enable_debug) {
+            assert(coherent());
+        }
+        return loaded;
+    }
+
     /// calls the eviction policy on all the objects in the cache
     void releaseMemory() {
-        if (storage_) {
+        if (storage_ || items_storage_) {
             //	call eviction policy
-            for (index_t i = lru_list_head_; i != -1; i = storage_[i].list_next) {
-                deletion_policy_.onDelete(storage_[i].key, storage_[i].value);
+            for (index_t i = lru_list_head_; i != -1; i = links(i).list_next) {
+                deletion_policy_.onDelete(item(i).key, item(i).value);
             }
         }
         //	free own memory
-        delete[] bucket_;
-        bucket_ = nullptr;
-        delete[] storage_;
-        storage_ = nullptr;
+        bucket_.reset();
+        storage_.reset();
+        links_storage_.reset();
+        items_storage_.reset();
+        swiss_index_.release();
     }
 
     template <typename Producer, typename Consumer>
@@ -166,17 +391,126 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
     /// cache to stdout. Useful for debugging only.
     void dump();
 
-    void resetProfiler() { profile_stats_.reset(); }
+    void resetProfiler() {
+        profile_stats_.reset();
+        lock_profiler_.reset();
+    }
 
   private:
     static size_t memSizeForElements(size_t count) {
         return size_t(std::ceil(elementSize() * count));
     }
 
+    static constexpr size_t elementStorageSize() {
+        return SplitPayload ? sizeof(Links) + sizeof(Item) : sizeof(Element);
+    }
+
+    Links& links(index_t i) const { return SplitPayload ? links_storage_[i] : storage_[i]; }
+
+    size_t elementReserve() const {
+        return SplitPayload ? links_storage_.capacity() : storage_.capacity();
+    }
+
+    void growStorage(size_t count) {
+        if (SplitPayload) {
+            links_storage_.grow(count);
+            items_storage_.grow(count);
+        } else {
+            storage_.grow(count);
+        }
+    }
+
+    /**
+     * One step of resize, expects the lock to be held.
+     * @param count target capacity
+     * @param constructed number of constructed elements
+     * @return true if the capacity and the table reached the target
+     */
+    bool resizeStep(size_t count, size_t constructed) {
+        if (kReadBuffer) {
+            // eviction should see recent hits
+            drainReadBuffers();
+        }
+        for (; element_count_ < constructed; element_count_++) {
+            index_t i          = index_t(element_count_);
+            links(i).list_prev = kFreeElement;
+            links(i).list_next = empty_nodes_head_;
+            empty_nodes_head_  = i;
+        }
+
+        if (count > this->max_element_count_) {
+            this->max_element_count_ = std::min(count, element_count_);
+        } else {
+            this->max_element_count_ -= std::min(this->max_element_count_ - count, kResizeStep);
+        }
+        while (this->current_element_count_ > this->max_element_count_) {
+            evict();
+        }
+        this->total_mem_available_ = memSizeForElements(this->max_element_count_);
+
+        size_t target_buckets = std::min(
+            bucket_.capacity(),
+            size_t(std::ceil(this->max_element_count_ / config::hashTableLoadFactor())));
+        for (size_t i = 0; i < kResizeSplits && bucket_count_ < target_buckets; i++) {
+            splitBucket();
+        }
+
+        return this->max_element_count_ == count && bucket_count_ >= target_buckets;
+    }
+
+    /// Adds a bucket and moves over the elements of the bucket it splits, expects the lock
+    void splitBucket() {
+        size_t split = bucket_count_ - roundDownToPowerOfTwo(bucket_count_);
+        bucket_.grow(bucket_count_ + 1);
+        bucket_[bucket_count_] = -1;
+        bucket_count_++;
+
+        index_t current = bucket_[split];
+        bucket_[split]  = -1;
+        while (current != -1) {
+            index_t next = links(current).bucket_next;
+            pushToBucket(current, whichBucket(item(current).key));
+            current = next;
+        }
+    }
+
+    /// Inserts the element at the head of the bucket
+    void pushToBucket(index_t elem, index_t wbuck) {
+        links(elem).bucket_next = bucket_[wbuck];
+        if (bucket_[wbuck] != -1) {
+            links(bucket_[wbuck]).bucket_prev = elem;
+        }
+        links(elem).bucket_prev = -wbuck - 1;
+        bucket_[wbuck]          = elem;
+    }
+
+    Item& item(index_t i) const { return SplitPayload ? items_storage_[i] : storage_[i]; }
+
     /// might invalidate operator by evicting one object from the cache
     /// (eviction policy will be used)
     void insert(const key_t& k, const value_t& v) {
-        typename config::lock_guard_t lg(lock_);
+        if (kFlatCombining) {
+            size_t id = threadSlot();
+            if (id < kThreadSlots) {
+                CombiningSlot& slot = combining_slots_[id];
+                slot.is_insert      = true;
+                slot.key            = &k;
+                slot.value          = &v;
+                combine(slot);
+                return;
+            }
+        }
+
+        lock_profiler_.lock(LockClass::Global, lock_);
+        typename config::lock_guard_t lg(lock_, std::adopt_lock);
+        if (kReadBuffer) {
+            // eviction should see recent hits
+            drainReadBuffers();
+        }
+        insertLocked(k, v);
+    }
+
+    void insertLocked(const key_t& k, const value_t& v) {
         profile_stats_.head_accesses++;
 
         if (config::enable_debug) {
@@ -195,17 +529,29 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
             assert(newelem != -1);
         }
         // move current_element_count further
-        empty_nodes_head_ = storage_[newelem].list_next;
+        empty_nodes_head_ = links(newelem).list_next;
 
         // affect values
-        storage_[newelem].key   = k;
-        storage_[newelem].value = v;
+        item(newelem).key   = k;
+        item(newelem).value = v;
+
+        if (UseSwissIndex) {
+            if (!swiss_index_.insert(swissHash(k), newelem, keyEq(k))) {
+                // key was inserted concurrently or the probe window is full
+                links(newelem).list_prev = kFreeElement;
+                links(newelem).list_next = empty_nodes_head_;
+                empty_nodes_head_        = newelem;
+                this->current_element_count_--;
+                deletion_policy_.onDelete(item(newelem).key, item(newelem).value);
+                return;
+            }
+        }
 
         // insert newelem at end of list
-        storage_[newelem].list_prev = lru_list_tail_;
-        storage_[newelem].list_next = -1;
+        links(newelem).list_prev = lru_list_tail_;
+        links(newelem).list_next = -1;
         if (lru_list_tail_ != -1) {
-            storage_[lru_list_tail_].list_next = newelem;
+            links(lru_list_tail_).list_next = newelem;
         }
 
         lru_list_tail_ = newelem;
@@ -215,18 +561,15 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
             lru_list_head_ = lru_list_tail_;
         }
 
-        // insert newelem in bucket at the head
-        index_t wbuck = whichBucket(k);
-        if (config::enable_debug) {
-            assert(wbuck >= 0 && wbuck < bucket_count_);
-        }
+        if (!UseSwissIndex) {
+            // insert newelem in bucket at the head
+            index_t wbuck = whichBucket(k);
+            if (config::enable_debug) {
+                assert(wbuck >= 0 && wbuck < bucket_count_);
+            }
 
-        storage_[newelem].bucket_next = bucket_[wbuck];
-        if (bucket_[wbuck] != -1) {
-            storage_[bucket_[wbuck]].bucket_prev = newelem;
+            pushToBucket(newelem, wbuck);
         }
-        storage_[newelem].bucket_prev = -wbuck - 1;
-        bucket_[wbuck]                = newelem;
 
         if (config::enable_debug) {
             assert(coherent());
@@ -235,61 +578,222 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
 
     template <typename Consumer>
     bool find(const key_t& k, Consumer& consumer) {
-        typename config::lock_guard_t lg(lock_);
+        if (kFlatCombining) {
+            size_t id = threadSlot();
+            if (id < kThreadSlots) {
+                CombiningSlot& slot = combining_slots_[id];
+                slot.is_insert      = false;
+                slot.key            = &k;
+                combine(slot);
+                if (slot.found) {
+                    consumer = slot.result;
+                }
+                return slot.found;
+            }
+        }
+        if constexpr (kReadBuffer) {
+            size_t id = threadSlot();
+            if (id < kThreadSlots) {
+                return findBuffered(k, consumer, read_buffers_[id]);
+            }
+        }
+
+        lock_profiler_.lock(LockClass::Global, lock_);
+        typename config::lock_guard_t lg(lock_, std::adopt_lock);
+        return findLocked(k, consumer);
+    }
+
+    template <typename Consumer>
+    bool findLocked(const key_t& k, Consumer& consumer) {
         profile_stats_.head_accesses++;
 
-        index_t wbuck = whichBucket(k);
+        profile_stats_.find++;
+
         if (config::enable_debug) {
-            assert(wbuck >= 0 && wbuck < bucket_count_);
+            assert(coherent());
         }
 
-        profile_stats_.find++;
+        index_t current = findElement(k);
+        if (current == -1) {
+            return false;
+        }
 
-        index_t current = bucket_[wbuck];
+        if (promotion_sampler_.promote()) {
+            moveToTail(current);
+        }
+        consumer = item(current).value;
+        return true;
+    }
+
+    /// update LRU list, expects the lock to be held
+    void moveToTail(index_t current) {
+        if (current == lru_list_tail_) { // no update to be done otherwise
+            return;
+        }
+        Links& current_elem = links(current);
+
+        // remove first
+        if (current_elem.list_prev == -1) { // at the beginning
+            lru_list_head_ = current_elem.list_next;
+        } else { // somewhere inside
+            links(current_elem.list_prev).list_next = current_elem.list_next;
+        }
+
+        links(current_elem.list_next).list_prev = current_elem.list_prev;
+
+        // then insert
+        current_elem.list_next          = -1;
+        links(lru_list_tail_).list_next = current;
+        current_elem.list_prev          = lru_list_tail_;
+        lru_list_tail_                  = current;
 
         if (config::enable_debug) {
             assert(coherent());
         }
+    }
 
-        while (current != -1) {
-            Element& current_elem = storage_[current];
-
-            if (current_elem.key == k) {
-                // update LRU list
-                if (current != lru_list_tail_) { // no update to be done otherwise
-                    // remove first
-                    if (current_elem.list_prev == -1) { // at the beginning
-                        lru_list_head_ = current_elem.list_next;
-                    } else { // somewhere inside
-                        storage_[current_elem.list_prev].list_next = current_elem.list_next;
-                    }
+    /**
+     * Hit without reordering the list, the element is recorded in the read buffer instead.
+     * Lookups only read the table, so concurrent hits share the lock.
+     */
+    template <typename Consumer>
+    bool findBuffered(const key_t& k, Consumer& consumer, ReadBuffer& buffer) {
+        lock_profiler_.lockShared(LockClass::Global, lock_);
+        profile_stats_.find++;
+        index_t current = findElement(k);
+        if (current != -1) {
+            consumer = item(current).value;
+        }
+        lock_.unlock_shared();
+        if (current == -1) {
+            return false;
+        }
+        if (!promotion_sampler_.promote()) {
+            return true;
+        }
 
-                    storage_[current_elem.list_next].list_prev = current_elem.list_prev;
+        size_t written = buffer.written.load(std::memory_order_relaxed);
+        size_t pending = written - buffer.drained.load(std::memory_order_acquire);
+        if (pending < ReadBuffer::kSize) {
+            buffer.elements[written % ReadBuffer::kSize].store(current, std::memory_order_relaxed);
+            buffer.written.store(written + 1, std::memory_order_release);
+            pending++;
+        }
 
-                    // then insert
-                    current_elem.list_next             = -1;
-                    storage_[lru_list_tail_].list_next = current;
-                    current_elem.list_prev             = lru_list_tail_;
-                    lru_list_tail_                     = current;
+        if (pending >= kReadBufferDrainLevel && lock_profiler_.tryLock(LockClass::Global, lock_)) {
+            typename config::lock_guard_t lg(lock_, std::adopt_lock);
+            drainReadBuffers();
+        }
+        return true;
+    }
 
-                    if (config::enable_debug) {
-                        assert(coherent());
-                    }
+    /// Applies buffered hits of all threads to the list, expects the lock to be held
+    void drainReadBuffers() {
+        profile_stats_.head_accesses++;
+        size_t limit = slot_limit_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < limit; i++) {
+            ReadBuffer& buffer  = read_buffers_[i];
+            size_t      drained = buffer.drained.load(std::memory_order_relaxed);
+            size_t      written = buffer.written.load(std::memory_order_acquire);
+            for (; drained != written; drained++) {
+                index_t current =
+                    buffer.elements[drained % ReadBuffer::kSize].load(std::memory_order_relaxed);
+                // the element may have been evicted since the hit
+                if (links(current).list_prev != kFreeElement) {
+                    moveToTail(current);
                 }
+            }
+            buffer.drained.store(written, std::memory_order_release);
+        }
+    }
 
-                consumer = current_elem.value;
-                return true;
+    /// @return id of the combining slot or read buffer of the calling thread,
+    ///         kThreadSlots if it has none
+    size_t threadSlot() {
+        static std::atomic<size_t> next_id{0};
+        thread_local const size_t  id = next_id.fetch_add(1, std::memory_order_relaxed);
+        if (id >= kThreadSlots) {
+            return kThreadSlots;
+        }
+
+        size_t limit = slot_limit_.load(std::memory_order_relaxed);
+        while (limit <= id && !slot_limit_.compare_exchange_weak(limit, id + 1)) {
+        }
+        return id;
+    }
+
+    /// Publishes the operation of the slot and returns once some combiner has applied it
+    void combine(CombiningSlot& slot) {
+        slot.pending.store(true, std::memory_order_release);
+        SpinBackoff backoff;
+        while (slot.pending.load(std::memory_order_acquire)) {
+            if (lock_profiler_.tryLock(LockClass::Global, lock_)) {
+                typename config::lock_guard_t lg(lock_, std::adopt_lock);
+                for (int pass = 0; pass < kCombiningPasses && applyPublished(); pass++) {
+                }
+                // own request was published before taking the lock, so it is done
+                break;
+            }
+            lock_profiler_.spin(LockClass::Global);
+            backoff.wait();
+        }
+    }
+
+    /// Applies pending operations of all slots, expects the lock to be held
+    /// @return true if there were any
+    bool applyPublished() {
+        size_t limit   = slot_limit_.load(std::memory_order_acquire);
+        bool   applied = false;
+        for (size_t i = 0; i < limit; i++) {
+            CombiningSlot& slot = combining_slots_[i];
+            if (!slot.pending.load(std::memory_order_acquire)) {
+                continue;
+            }
+            if (slot.is_insert) {
+                insertLocked(*slot.key, *slot.value);
+            } else {
+                slot.found = findLocked(*slot.key, slot.result);
             }
+            slot.pending.store(false, std::memory_order_release);
+            applied = true;
+        }
+        return applied;
+    }
+
+    /// returns index of the element holding the key or -1
+    index_t findElement(const key_t& k) const {
+        if (UseSwissIndex) {
+            index_t current = swiss_index_.find(swissHash(k), keyEq(k));
+            return current == swiss_t::npos ? -1 : current;
+        }
+
+        index_t wbuck = whichBucket(k);
+        if (config::enable_debug) {
+            assert(wbuck >= 0 && wbuck < bucket_count_);
+        }
 
-            current = current_elem.bucket_next;
+        index_t current = bucket_[wbuck];
+        while (current != -1) {
+            if (item(current).key == k) {
+                return current;
+            }
+            current = links(current).bucket_next;
         }
 
         // if I reach here, the object is not found
-        return false;
+        return -1;
+    }
+
+    size_t swissHash(const key_t& k) const { return h_(k); }
+
+    auto keyEq(const key_t& k) const {
+        return [this, &k](index_t i) { return item(i).key == k; };
     }
 
     /// chose which bucket a key is affected to.
-    int whichBucket(const key_t& k) const { return (h_(k) >> IgnoreBitsInHash) % bucket_count_; }
+    int whichBucket(const key_t& k) const {
+        return int(linearHashBucket(h_(k) >> IgnoreBitsInHash, bucket_count_));
+    }
 
     void evict() {
         if (config::enable_debug) {
@@ -301,22 +805,30 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
             assert(victim >= 0);
         }
         // the successor of victim in list is the new head of list
-        lru_list_head_                     = storage_[victim].list_next;
-        storage_[lru_list_head_].list_prev = -1;
+        lru_list_head_                  = links(victim).list_next;
+        links(lru_list_head_).list_prev = -1;
 
         // victim is the new head of empty_nodes_head
-        storage_[victim].list_next = empty_nodes_head_;
-        empty_nodes_head_          = victim;
+        links(victim).list_prev = kFreeElement;
+        links(victim).list_next = empty_nodes_head_;
+        empty_nodes_head_       = victim;
 
         // remove victim from bucket
-        if (storage_[victim].bucket_prev < 0) {
-            bucket_[-storage_[victim].bucket_prev - 1] = storage_[victim].bucket_next;
+        if (UseSwissIndex) {
+            bool erased = swiss_index_.erase(swissHash(item(victim).key), victim);
+            if (config::enable_debug) {
+                assert(erased);
+            }
         } else {
-            storage_[storage_[victim].bucket_prev].bucket_next = storage_[victim].bucket_next;
-        }
+            if (links(victim).bucket_prev < 0) {
+                bucket_[-links(victim).bucket_prev - 1] = links(victim).bucket_next;
+            } else {
+                links(links(victim).bucket_prev).bucket_next = links(victim).bucket_next;
+            }
 
-        if (storage_[victim].bucket_next >= 0) {
-            storage_[storage_[victim].bucket_next].bucket_prev = storage_[victim].bucket_prev;
+            if (links(victim).bucket_next >= 0) {
+                links(links(victim).bucket_next).bucket_prev = links(victim).bucket_prev;
+            }
         }
 
         if (config::enable_debug) {
@@ -325,7 +837,7 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
         this->current_element_count_--;
 
         // call eviction policy
-        deletion_policy_.onDelete(storage_[victim].key, storage_[victim].value);
+        deletion_policy_.onDelete(item(victim).key, item(victim).value);
 
         if (config::enable_debug) {
             assert(coherent());
@@ -337,8 +849,8 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
     bool coherent() {
         {
             int nbcount = 0;
-            for (index_t i = empty_nodes_head_; i != -1; i = storage_[i].list_next, nbcount++) {
-                if (nbcount > this->max_element_count_) { // no loop
+            for (index_t i = empty_nodes_head_; i != -1; i = links(i).list_next, nbcount++) {
+                if (nbcount > element_count_) { // no loop
                     return false;
                 }
             }
@@ -346,19 +858,24 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
 
         {
             int nbcount_for = 0;
-            for (index_t i = lru_list_head_; i != -1; i = storage_[i].list_next, nbcount_for++) {
+            for (index_t i = lru_list_head_; i != -1; i = links(i).list_next, nbcount_for++) {
                 if (nbcount_for > this->max_element_count_) { // no loop
                     return false;
                 }
-                if (storage_[i].bucket_prev < 0) { // head of bucket properly set (weaker test)
-                    if (whichBucket(storage_[i].key) != -storage_[i].bucket_prev - 1) {
+                if (UseSwissIndex) {
+                    if (findElement(item(i).key) != i) { // element is reachable by its key
+                        return false;
+                    }
+                } else if (links(i).bucket_prev < 0) {
+                    // head of bucket properly set (weaker test)
+                    if (whichBucket(item(i).key) != -links(i).bucket_prev - 1) {
                         return false;
                     }
                 }
             }
 
             int nbcount_back = 0;
-            for (index_t i = lru_list_tail_; i != -1; i = storage_[i].list_prev, nbcount_back++) {
+            for (index_t i = lru_list_tail_; i != -1; i = links(i).list_prev, nbcount_back++) {
                 if (nbcount_back > this->max_element_count_) { // no loop
                     return false;
                 }
@@ -373,16 +890,16 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
             for (int j = 0; j < bucket_count_; j++) {
                 index_t i;
                 int     nbcount = 0;
-                for (i = bucket_[j]; i >= 0; nbcount++, i = storage_[i].bucket_next) {
+                for (i = bucket_[j]; i >= 0; nbcount++, i = links(i).bucket_next) {
                     if (i == this->current_element_count_) {
                         // an element in a bucket is not in the empty list (test weaker)
                         return false;
                     }
-                    if (j != whichBucket(storage_[i].key)) { // is the element in the right bucket
+                    if (j != whichBucket(item(i).key)) { // is the element in the right bucket
                         return false;
                     }
-                    if (storage_[i].bucket_next == storage_[i].bucket_prev &&
-                        storage_[i].bucket_prev >= 0) { // no cycle (test weaker)
+                    if (links(i).bucket_next == links(i).bucket_prev &&
+                        links(i).bucket_prev >= 0) { // no cycle (test weaker)
                         return false;
                     }
                     if (nbcount > this->max_element_count_) { // no loop
@@ -396,31 +913,42 @@ class LRUCache : public ContainerBase<Config, LRUCache<Config, IgnoreBitsInHash>
     }
 
     // We have to use composition to preserve late initialization semantic
-    Element* storage_;
-    index_t* bucket_; // give head of bucket
-    index_t  lru_list_head_;
-    index_t  lru_list_tail_;
-    index_t  empty_nodes_head_;
-
-    size_t bucket_count_;
-
-    typename config::hasher_t        h_;
-    typename config::deletion_policy deletion_policy_;
-    typename config::locking_t       lock_;
-    typename config::profile_stats_t profile_stats_;
+    NodeArray<Element> storage_;
+    NodeArray<Links>   links_storage_; // SplitPayload only
+    NodeArray<Item>    items_storage_; // SplitPayload only
+    NodeArray<index_t> bucket_;        // give head of bucket
+    index_t            lru_list_head_;
+    index_t            lru_list_tail_;
+    index_t            empty_nodes_head_;
+
+    size_t  element_count_; ///< constructed elements, more than the capacity after a shrink
+    size_t  bucket_count_;
+    swiss_t swiss_index_;
+
+    typename config::index_hasher_t      h_;
+    typename config::deletion_policy     deletion_policy_;
+    typename config::locking_t           lock_;
+    typename config::profile_stats_t     profile_stats_;
+    typename config::lock_profiler_t     lock_profiler_;
+    typename config::promotion_sampler_t promotion_sampler_;
+
+    std::unique_ptr<CombiningSlot[]> combining_slots_; // FlatCombining only
+    std::unique_ptr<ReadBuffer[]>    read_buffers_;    // ReadBuffer only
+    std::atomic<size_t>              slot_limit_{0};   ///< one past the largest thread slot in use
 };
 
-template <typename Config, unsigned int IgnoreBitsInHash>
-void LRUCache<Config, IgnoreBitsInHash>::dump() {
+template <typename Config, unsigned int IgnoreBitsInHash, bool UseSwissIndex, bool SplitPayload,
+          LruListSync ListSync>
+void LRUCache<Config, IgnoreBitsInHash, UseSwissIndex, SplitPayload, ListSync>::dump() {
     std::cout << "--- raw ---" << std::endl;
     std::cout << "list_head:" << lru_list_head_ << " list_tail: " << lru_list_tail_ << std::endl;
     std::cout << "current_element_count: " << this->current_element_count_ << std::endl;
 
     std::cout << "storage" << std::endl;
     for (index_t i = 0; i < this->current_element_count_; i++) {
-        Element& e = storage_[i];
+        Links& e = links(i);
         std::cout << i << " : " << e.list_prev << " " << e.list_next << " " << e.bucket_prev << " "
-                  << e.bucket_next << " " << e.key << " " << e.value << std::endl;
+                  << e.bucket_next << " " << item(i).key << " " << item(i).value << std::endl;
     }
 
     std::cout << "bucket" << std::endl;
@@ -429,15 +957,15 @@ void LRUCache<Config, IgnoreBitsInHash>::dump() {
     }
     std::cout << "--- pretty ---" << std::endl;
     std::cout << "empty list" << std::endl;
-    for (index_t i = this->current_element_count_; i != -1; i = storage_[i].list_next)
+    for (index_t i = this->current_element_count_; i != -1; i = links(i).list_next)
         std::cout << i << " ";
     std::cout << std::endl;
     std::cout << "LRU list" << std::endl;
-    for (index_t i = lru_list_head_; i != -1; i = storage_[i].list_next)
+    for (index_t i = lru_list_head_; i != -1; i = links(i).list_next)
         std::cout << i << " ";
     std::cout << std::endl;
     std::cout << "LRU list (in reverse)" << std::endl;
-    for (index_t i = lru_list_tail_; i != -1; i = storage_[i].list_prev)
+    for (index_t i = lru_list_tail_; i != -1; i = links(i).list_prev)
         std::cout << i << " ";
     std::cout << std::endl;
     std::cout << "buckets" << std::endl;
@@ -446,13 +974,13 @@ void LRUCache<Config, IgnoreBitsInHash>::dump() {
         index_t old_i   = -1;
         int     nbcount = 0;
         for (i     = bucket_[j]; i >= 0 && nbcount < this->max_element_count_;
-             old_i = i, i = storage_[i].bucket_next, nbcount++) {
+             old_i = i, i = links(i).bucket_next, nbcount++) {
             assert(old_i != i);
             std::cout << i << " ";
         }
         i = old_i;
         std::cout << "// ";
-        for (; i >= 0; i = storage_[i].bucket_prev)
+        for (; i >= 0; i = links(i).bucket_prev)
             std::cout << i << " ";
         std::cout << std::endl;
     }
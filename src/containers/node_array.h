@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "topology.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+enum class PageKind {
+    Default,     ///< heap allocation, 4K pages
+    Transparent, ///< 2MB aligned mapping advised with MADV_HUGEPAGE
+    Huge2M,      ///< MAP_HUGETLB with 2MB pages, requires vm.nr_hugepages
+    Huge1G       ///< MAP_HUGETLB with 1GB pages, requires reserved gigantic pages
+};
+
+enum class NumaPolicy {
+    Default,    ///< first touch by the thread that allocates the container
+    Interleave, ///< pages are interleaved over all online nodes
+    FirstTouch, ///< nodes are constructed by NodePlacement::touch_threads workers
+    Preferred   ///< pages are allocated on NodePlacement::node if possible
+};
+
+/**
+ * # NodePlacement
+ * Where node arrays of the containers are placed in memory.
+ *
+ * Containers take their capacity only, so the placement is a process-wide
+ * setting that the benchmark selects before constructing a container.
+ * FirstTouch constructs the array with a static OpenMP schedule,
+ * so every worker faults in (and owns on its NUMA node) a contiguous slice.
+ */
+struct NodePlacement {
+    PageKind   pages         = PageKind::Default;
+    NumaPolicy numa          = NumaPolicy::Default;
+    unsigned   touch_threads = 1;
+    unsigned   node          = 0; ///< CpuTopology node index, Preferred only
+    double     max_growth    = 1; ///< resize() can grow a container up to this multiple
+
+    /// Elements reserved for a container of capacity elements that may grow by max_growth
+    size_t reserveCount(size_t capacity) const {
+        return std::max(capacity, size_t(capacity * max_growth));
+    }
+
+    bool isDefault() const { return pages == PageKind::Default && numa == NumaPolicy::Default; }
+
+    static NodePlacement& global() {
+        static NodePlacement placement;
+        return placement;
+    }
+
+    static PageKind parsePages(const std::string& s) {
+        if (s == "default") {
+            return PageKind::Default;
+        } else if (s == "thp") {
+            return PageKind::Transparent;
+        } else if (s == "2m") {
+            return PageKind::Huge2M;
+        } else if (s == "1g") {
+            return PageKind::Huge1G;
+        }
+        throw std::runtime_error("Unknown page kind: " + s);
+    }
+
+    static NumaPolicy parseNuma(const std::string& s) {
+        if (s == "default") {
+            return NumaPolicy::Default;
+        } else if (s == "interleave") {
+            return NumaPolicy::Interleave;
+        } else if (s == "first-touch") {
+            return NumaPolicy::FirstTouch;
+        }
+        throw std::runtime_error("Unknown NUMA policy: " + s);
+    }
+};
+
+namespace detail {
+
+constexpr size_t kSmallPageSize = 4096;
+constexpr size_t kHugePageSize  = size_t(2) << 20;
+constexpr size_t kGiantPageSize = size_t(1) << 30;
+
+inline size_t roundUp(size_t size, size_t page) { return (size + page - 1) / page * page; }
+
+inline std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+inline uint64_t onlineNumaNodes() {
+    uint64_t mask = 0;
+    for (unsigned n : readCpuList("/sys/devices/system/node/online")) {
+        if (n < 64) {
+            mask |= uint64_t(1) << n;
+        }
+    }
+    return mask ? mask : 1;
+}
+
+/// Maps size bytes (rounded up to the page size) and applies the placement.
+/// @return mapping address, size is updated to the mapped length
+inline void* mapNodeMemory(size_t& size, const NodePlacement& placement) {
+    void* p = MAP_FAILED;
+    switch (placement.pages) {
+    case PageKind::Huge2M:
+    case PageKind::Huge1G: {
+        bool   giant = placement.pages == PageKind::Huge1G;
+        size_t page  = giant ? kGiantPageSize : kHugePageSize;
+        int    flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+        flags |= (giant ? 30 : 21) << MAP_HUGE_SHIFT;
+        size = roundUp(size, page);
+        p    = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED) {
+            throw systemError(std::string("Failed to map ") + (giant ? "1GB" : "2MB") +
+                              " huge pages (are they reserved in /proc/sys/vm?)");
+        }
+        break;
+    }
+    case PageKind::Transparent: {
+        // Overmap to cut out a 2MB aligned range, otherwise the head and the tail
+        // of the array are not eligible for huge pages
+        size          = roundUp(size, kHugePageSize);
+        size_t mapped = size + kHugePageSize;
+        auto*  raw    = static_cast<char*>(
+            mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (raw == MAP_FAILED) {
+            throw systemError("Failed to map node memory");
+        }
+        auto* aligned = reinterpret_cast<char*>(roundUp(uintptr_t(raw), kHugePageSize));
+        if (aligned != raw) {
+            munmap(raw, aligned - raw);
+        }
+        if (aligned + size != raw + mapped) {
+            munmap(aligned + size, raw + mapped - (aligned + size));
+        }
+        p = aligned;
+        // THP may be disabled system-wide, the mapping is still usable then
+        madvise(p, size, MADV_HUGEPAGE);
+        break;
+    }
+    case PageKind::Default:
+        size = roundUp(size, kSmallPageSize);
+        p    = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            throw systemError("Failed to map node memory");
+        }
+        break;
+    }
+
+    if (placement.numa == NumaPolicy::Interleave || placement.numa == NumaPolicy::Preferred) {
+        // Raw syscall to avoid dependency on libnuma
+        constexpr int kMpolPreferred  = 1;
+        constexpr int kMpolInterleave = 3;
+        int           mode            = kMpolInterleave;
+        uint64_t      nodes           = onlineNumaNodes();
+        if (placement.numa == NumaPolicy::Preferred) {
+            mode  = kMpolPreferred;
+            nodes = uint64_t(1) << CpuTopology::get().nodeId(placement.node);
+        }
+        if (syscall(SYS_mbind, p, size, mode, &nodes, 64, 0) != 0) {
+            munmap(p, size);
+            throw systemError("Failed to bind node memory");
+        }
+    }
+    return p;
+}
+
+} // namespace detail
+
+/**
+ * # NodeArray
+ * Owning array of container nodes, a replacement for unique_ptr<T[]>
+ * that places the nodes according to NodePlacement.
+ *
+ * The default placement allocates from the heap, as new T[] does.
+ * Other placements use an anonymous mapping, which stays untouched until
+ * the nodes are constructed, so construction determines the NUMA node of each page.
+ *
+ * reserve() maps address space for more elements than it constructs,
+ * grow() constructs them later in place, so the array grows
+ * without moving nodes and untouched pages take no memory.
+ */
+template <typename T>
+class NodeArray {
+  public:
+    NodeArray() = default;
+
+    NodeArray(const NodeArray&) = delete;
+
+    NodeArray& operator=(const NodeArray&) = delete;
+
+    ~NodeArray() { reset(); }
+
+    void allocate(size_t count, const NodePlacement& placement = NodePlacement::global()) {
+        reserve(count, count, placement);
+    }
+
+    /// Maps capacity elements and constructs the first count of them
+    void reserve(size_t count, size_t capacity,
+                 const NodePlacement& placement = NodePlacement::global()) {
+        reset();
+        if (capacity == 0) {
+            return;
+        }
+        if (placement.isDefault() && count == capacity) {
+            data_     = new T[count];
+            size_     = count;
+            capacity_ = count;
+            return;
+        }
+
+        size_t bytes   = capacity * sizeof(T);
+        data_          = static_cast<T*>(detail::mapNodeMemory(bytes, placement));
+        capacity_      = capacity;
+        mapped_bytes_  = bytes;
+        touch_threads_ =
+            placement.numa == NumaPolicy::FirstTouch ? std::max(placement.touch_threads, 1u) : 1;
+        grow(count);
+    }
+
+    /// Constructs elements up to count, which must be within the reserved capacity
+    void grow(size_t count) {
+        if (count > capacity_) {
+            throw std::runtime_error("Node array grows beyond its reserved capacity");
+        }
+        if (count <= size_) {
+            return;
+        }
+        T*     data  = data_;
+        size_t first = size_;
+        if (touch_threads_ > 1) {
+#pragma omp parallel for num_threads(touch_threads_) schedule(static)
+            for (size_t i = first; i < count; i++) {
+                new (&data[i]) T;
+            }
+        } else {
+            for (size_t i = first; i < count; i++) {
+                new (&data[i]) T;
+            }
+        }
+        size_ = count;
+    }
+
+    void reset() {
+        if (!data_) {
+            return;
+        }
+        if (mapped_bytes_ == 0) {
+            delete[] data_;
+        } else {
+            if constexpr (!std::is_trivially_destructible<T>::value) {
+                for (size_t i = 0; i < size_; i++) {
+                    data_[i].~T();
+                }
+            }
+            munmap(data_, mapped_bytes_);
+        }
+        data_          = nullptr;
+        size_          = 0;
+        capacity_      = 0;
+        mapped_bytes_  = 0;
+        touch_threads_ = 1;
+    }
+
+    T* get() const { return data_; }
+
+    /// Number of constructed elements
+    size_t size() const { return size_; }
+
+    size_t capacity() const { return capacity_; }
+
+    T& operator[](size_t i) const { return data_[i]; }
+
+    T* begin() const { return data_; }
+
+    T* end() const { return data_ + size_; }
+
+    explicit operator bool() const { return data_ != nullptr; }
+
+  private:
+    T*       data_          = nullptr;
+    size_t   size_          = 0;
+    size_t   capacity_      = 0;
+    size_t   mapped_bytes_  = 0;
+    unsigned touch_threads_ = 1;
+};
+
+/**
+ * Overrides the global NodePlacement for containers allocated in its scope.
+ */
+class ScopedNodePlacement {
+  public:
+    explicit ScopedNodePlacement(const NodePlacement& placement)
+        : saved_(NodePlacement::global()) {
+        NodePlacement::global() = placement;
+    }
+
+    ScopedNodePlacement(const ScopedNodePlacement&) = delete;
+
+    ~ScopedNodePlacement() { NodePlacement::global() = saved_; }
+
+  private:
+    NodePlacement saved_;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "utility.h"
+
+template <typename T>
+bool ptrIsMarked(const T* p) {
+    return uintptr_t(p) & 1;
+}
+
+template <typename T>
+T* markPtr(T* p) {
+    return reinterpret_cast<T*>(uintptr_t(p) | 1u);
+}
+
+template <typename T>
+T* extractPtr(T* p) {
+    return reinterpret_cast<T*>(uintptr_t(p) & ~uintptr_t(1));
+}
+
+/**
+ * # NodeLinks
+ * Representation of links between nodes of a container-owned node array.
+ *
+ * With IndexT = void a link is a plain pointer.
+ * Otherwise it is an index into the node array, which makes nodes
+ * with several links considerably smaller (4 or 2 bytes per link instead of 8).
+ * Conversion to a pointer is a single add, so algorithms are written
+ * in terms of pointers and links are converted on load/store.
+ *
+ * null() is the end of a list and is never marked. Link marking (see ptrIsMarked)
+ * uses the lowest bit of a pointer or the highest bit of an index, so index links
+ * address at most maxNodeCount() nodes including sentinels.
+ *
+ * @tparam NodeT type that the links point to
+ * @tparam ArrayNodeT type of the array elements, derived from NodeT
+ * @tparam IndexT void, uint32_t or uint16_t
+ */
+template <typename NodeT, typename ArrayNodeT, typename IndexT>
+class NodeLinks {
+  public:
+    static constexpr bool is_index = !std::is_void<IndexT>::value;
+
+    using link_t = std::conditional_t<is_index, IndexT, NodeT*>;
+
+    static_assert(!is_index || std::is_unsigned<link_t>::value, "Index links must be unsigned");
+
+    static constexpr link_t null() {
+        if constexpr (is_index) {
+            return std::numeric_limits<link_t>::max();
+        } else {
+            return nullptr;
+        }
+    }
+
+    static constexpr size_t maxNodeCount() {
+        if constexpr (is_index) {
+            return size_t(markBit()) - 1;
+        } else {
+            return std::numeric_limits<size_t>::max();
+        }
+    }
+
+    static bool isMarked(link_t l) {
+        if constexpr (is_index) {
+            return l != null() && (l & markBit()) != 0;
+        } else {
+            return ptrIsMarked(l);
+        }
+    }
+
+    static link_t mark(link_t l) {
+        if constexpr (is_index) {
+            return link_t(l | markBit());
+        } else {
+            return markPtr(l);
+        }
+    }
+
+    void reset(ArrayNodeT* array) { array_ = array; }
+
+    NodeT* toNode(link_t l) const {
+        if constexpr (is_index) {
+            return l == null() ? nullptr : static_cast<NodeT*>(&array_[l]);
+        } else {
+            return l;
+        }
+    }
+
+    link_t toLink(NodeT* node) const {
+        if constexpr (is_index) {
+            return node ? link_t(static_cast<ArrayNodeT*>(node) - array_) : null();
+        } else {
+            return node;
+        }
+    }
+
+  private:
+    static constexpr link_t markBit() {
+        if constexpr (is_index) {
+            return link_t(link_t(1) << (sizeof(link_t) * 8 - 1));
+        } else {
+            return 1;
+        }
+    }
+
+    ArrayNodeT* array_ = nullptr;
+};
+
+/**
+ * Sentinel nodes are kept in the node array next to the data nodes,
+ * so they are addressable by index links. Sentinels are placed this many
+ * nodes apart to never share a cache line.
+ */
+template <typename ArrayNodeT>
+constexpr size_t sentinelStride() {
+    return 1 + (64 + sizeof(ArrayNodeT) - 1) / sizeof(ArrayNodeT);
+}
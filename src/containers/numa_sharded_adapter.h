@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "containers/deferred_lru.h"
+#include "containers/node_array.h"
+#include "topology.h"
+
+enum class NumaRouting {
+    KeyHash,     ///< every key has a single home shard, threads on other nodes access it remotely
+    ReplicateHot ///< threads look up their local node first, hot keys get a replica on each node
+};
+
+struct NumaAccessStats {
+    size_t local;
+    size_t remote;
+
+    double localRatio() const { return local + remote ? double(local) / (local + remote) : 1; }
+};
+
+/**
+ * # NumaShardedAdapter
+ * Shards a container like BucketedAdapter, but groups the shards by NUMA node.
+ * Node arrays of each group are placed on the memory of its node (see NodePlacement).
+ *
+ * A key hashes to a home node and a shard within the group.
+ * With NumaRouting::ReplicateHot a thread looks up the same shard of its own node first.
+ * A local miss is served by the home shard and the value is replicated locally,
+ * so keys that keep being hit stay on every node that uses them,
+ * while cold replicas are evicted by the local LRU.
+ *
+ * Accesses are counted per CPU as local if they were served
+ * without touching a remote group, see accessStats().
+ */
+template <typename Config, typename ContainerT, unsigned LogShardsPerNode, NumaRouting Routing>
+class NumaShardedAdapter {
+    using key_t   = typename Config::key_t;
+    using value_t = typename Config::value_t;
+
+    struct CACHELINE_ALIGN AccessCounter {
+        std::atomic<size_t> local{0};
+        std::atomic<size_t> remote{0};
+    };
+
+  public:
+    NumaShardedAdapter()
+        : node_count_(CpuTopology::get().nodeCount()),
+          counter_count_(CpuTopology::get().cpuLimit()) {
+        containers_.reset(new ContainerT[node_count_ * shardsPerNode()]);
+        counters_.reset(new AccessCounter[counter_count_]);
+    }
+
+    NumaShardedAdapter(size_t capacity, bool is_item_capacity) : NumaShardedAdapter() {
+        allocateMemory(capacity, is_item_capacity);
+    }
+
+    static constexpr size_t shardsPerNode() { return 1u << LogShardsPerNode; }
+
+    size_t shardCount() const { return node_count_ * shardsPerNode(); }
+
+    void allocateMemory(size_t capacity, bool is_item_capacity) {
+        NodePlacement placement = NodePlacement::global();
+        placement.numa          = NumaPolicy::Preferred;
+        for (size_t node = 0; node < node_count_; node++) {
+            placement.node = unsigned(node);
+            ScopedNodePlacement scope(placement);
+            for (size_t i = 0; i < shardsPerNode(); i++) {
+                size_t nr = node * shardsPerNode() + i;
+                containers_[nr].allocateMemory(evenShare(capacity, shardCount(), nr),
+                                               is_item_capacity);
+            }
+        }
+    }
+
+    /// calls the policy on all the objects in the cache
+    void releaseMemory() {
+        for (size_t i = 0; i < shardCount(); i++) {
+            containers_[i].releaseMemory();
+        }
+    }
+
+    static const char* name() {
+        static std::string s = std::string(Routing == NumaRouting::KeyHash ? "NumaHash_"
+                                                                           : "NumaReplicated_") +
+                               ContainerT::name();
+        return s.c_str();
+    }
+
+    decltype(auto) profileStats() const {
+        auto res = containers_[0].profileStats();
+        for (size_t i = 1; i < shardCount(); i++)
+            res += containers_[i].profileStats();
+        return res;
+    }
+
+    /// Lock profiles of all shards, hot buckets are reported with their shard number
+    LockProfileReport lockProfile() const {
+        LockProfileReport res;
+        for (size_t i = 0; i < shardCount(); i++) {
+            res.merge(containers_[i].lockProfile(), i);
+        }
+        return res;
+    }
+
+    template <typename Producer, typename Consumer>
+    bool consumeCachedOrCompute(const key_t& key, const Producer& producer, Consumer& consumer) {
+        size_t   mixed   = mixHash(hasher_(key));
+        size_t   shard   = shardInGroup(mixed);
+        size_t   home    = homeNode(mixed);
+        int      cpu     = sched_getcpu();
+        unsigned local   = CpuTopology::get().nodeOfCpu(unsigned(cpu));
+        auto&    counter = counters_[size_t(cpu) % counter_count_];
+
+        if (Routing == NumaRouting::KeyHash || home == local) {
+            auto& kind = home == local ? counter.local : counter.remote;
+            kind.fetch_add(1, std::memory_order_relaxed);
+            return container(home, shard).consumeCachedOrCompute(key, producer, consumer);
+        }
+
+        bool home_hit = false;
+        bool remote   = false;
+        bool hit      = container(local, shard).consumeCachedOrCompute(
+            key,
+            [&]() {
+                value_t value;
+                remote   = true;
+                home_hit = container(home, shard).consumeCachedOrCompute(key, producer, value);
+                return value;
+            },
+            consumer);
+        (remote ? counter.remote : counter.local).fetch_add(1, std::memory_order_relaxed);
+        return hit || home_hit;
+    }
+
+    NumaAccessStats accessStats() const {
+        NumaAccessStats res{0, 0};
+        for (size_t i = 0; i < counter_count_; i++) {
+            res.local += counters_[i].local.load(std::memory_order_relaxed);
+            res.remote += counters_[i].remote.load(std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+    MemStats memStats() const {
+        auto res = containers_[0].memStats();
+        for (size_t i = 1; i < shardCount(); i++) {
+            res += containers_[i].memStats();
+        }
+
+        return res;
+    }
+
+    size_t currentOverheadMemory() const {
+        auto res = containers_[0].currentOverheadMemory();
+        for (size_t i = 1; i < shardCount(); i++) {
+            res += containers_[i].currentOverheadMemory();
+        }
+
+        return res;
+    }
+
+    void resetProfiler() {
+        for (size_t i = 0; i < shardCount(); i++) {
+            containers_[i].resetProfiler();
+        }
+        for (size_t i = 0; i < counter_count_; i++) {
+            counters_[i].local  = 0;
+            counters_[i].remote = 0;
+        }
+    }
+
+  private:
+    ContainerT& container(size_t node, size_t shard) {
+        return containers_[node * shardsPerNode() + shard];
+    }
+
+    /**
+     * Containers index their tables with the low bits of the mixed hash,
+     * so the shard and the home node are chosen by the high bits.
+     */
+    static size_t shardInGroup(size_t mixed) {
+        if (LogShardsPerNode == 0) {
+            return 0;
+        }
+        return mixed >> (sizeof(size_t) * 8 - LogShardsPerNode);
+    }
+
+    size_t homeNode(size_t mixed) const {
+        // Multiply-shift maps 32 hash bits below the shard bits onto [0, node_count_)
+        uint64_t bits = (mixed >> (32 - LogShardsPerNode)) & UINT32_MAX;
+        return size_t((bits * node_count_) >> 32);
+    }
+
+    size_t                           node_count_;
+    size_t                           counter_count_;
+    typename Config::hasher_t        hasher_;
+    std::unique_ptr<ContainerT[]>    containers_;
+    std::unique_ptr<AccessCounter[]> counters_;
+};
+
+template <typename Config, NumaRouting Routing>
+class NumaDeferredLRU : public NumaShardedAdapter<Config, DeferredLRU<Config>, 5, Routing> {
+    using NumaShardedAdapter<Config, DeferredLRU<Config>, 5, Routing>::NumaShardedAdapter;
+};
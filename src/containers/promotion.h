@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "utility.h"
+
+/**
+ * # PromotionSampling
+ * Share of hits that move an element to the most recently used end of the list.
+ *
+ * A skipped promotion saves the list update and the locks it takes,
+ * the price is a less exact LRU order and a slightly lower hit rate.
+ * Like NodePlacement it is a process-wide setting that containers read
+ * when they are constructed.
+ */
+struct PromotionSampling {
+    double   probability = 1; ///< chance that a hit is promoted
+    unsigned every_nth   = 1; ///< only every Nth hit of a thread is promoted
+
+    bool isDefault() const { return probability >= 1 && every_nth <= 1; }
+
+    static PromotionSampling& global() {
+        static PromotionSampling sampling;
+        return sampling;
+    }
+
+    /// e.g. "p=0.25", "every=4", "p=0.5+every=2" or "always"
+    std::string describe() const {
+        if (isDefault()) {
+            return "always";
+        }
+        std::ostringstream out;
+        if (probability < 1) {
+            out << "p=" << probability;
+        }
+        if (every_nth > 1) {
+            out << (probability < 1 ? "+" : "") << "every=" << every_nth;
+        }
+        return out.str();
+    }
+};
+
+/**
+ * # PromotionSampler
+ * Decides whether a hit is promoted according to a PromotionSampling.
+ *
+ * Random numbers come from a xorshift32 generator and hits are counted
+ * per thread, so a decision costs a few instructions on thread local state.
+ */
+class PromotionSampler {
+  public:
+    explicit PromotionSampler(const PromotionSampling& sampling = PromotionSampling::global())
+        : threshold_(uint64_t(std::clamp(sampling.probability, 0., 1.) * kRandomRange)),
+          every_nth_(std::max(sampling.every_nth, 1u)), always_(sampling.isDefault()) {}
+
+    bool promote() const {
+        if (always_) {
+            return true;
+        }
+        ThreadState& state = threadState();
+        if (every_nth_ > 1 && ++state.hits % every_nth_ != 0) {
+            return false;
+        }
+        return state.next() < threshold_;
+    }
+
+  private:
+    static constexpr uint64_t kRandomRange = uint64_t(1) << 32u;
+
+    struct ThreadState {
+        uint32_t random;
+        uint32_t hits;
+
+        uint32_t next() {
+            random ^= random << 13u;
+            random ^= random >> 17u;
+            random ^= random << 5u;
+            return random;
+        }
+    };
+
+    static ThreadState& threadState() {
+        static std::atomic<uint32_t> seed{0};
+        // xorshift state must not be zero
+        thread_local ThreadState state{uint32_t(mixHash(seed.fetch_add(1) + 1)) | 1u, 0};
+        return state;
+    }
+
+    uint64_t threshold_; ///< promote if the next random number is below
+    unsigned every_nth_;
+    bool     always_;
+};
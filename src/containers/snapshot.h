@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "containers/node_array.h"
+
+/**
+ * # Snapshots
+ * Binary dump of the cache contents that warms a cache up after a restart.
+ *
+ * A snapshot is a SnapshotHeader followed by (key, value) records,
+ * from the most to the least recently used element, so a smaller cache
+ * restores the hottest prefix. The record count follows from the file size.
+ * Keys and values are copied bytewise, the file is only readable
+ * by a build with the same key and value layout.
+ */
+struct SnapshotHeader {
+    static constexpr char     kMagic[8] = {'L', 'R', 'U', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr uint32_t kVersion  = 1;
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint8_t  padding[40]; ///< records start at a cache line
+
+    template <typename RecordT>
+    static SnapshotHeader make() {
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version     = kVersion;
+        header.record_size = sizeof(RecordT);
+        header.key_size    = sizeof(RecordT::key);
+        header.value_size  = sizeof(RecordT::value);
+        return header;
+    }
+
+    bool matches(const SnapshotHeader& other) const {
+        return std::memcmp(magic, other.magic, sizeof(magic)) == 0 && version == other.version &&
+               record_size == other.record_size && key_size == other.key_size &&
+               value_size == other.value_size;
+    }
+};
+
+static_assert(sizeof(SnapshotHeader) == 64);
+
+template <typename KeyT, typename ValueT>
+struct SnapshotRecord {
+    KeyT   key;
+    ValueT value;
+};
+
+/**
+ * # SnapshotWriter
+ * Streams records to a snapshot file through an aligned buffer.
+ *
+ * The file is opened with O_DIRECT where the file system supports it,
+ * so a large dump bypasses the page cache instead of evicting
+ * the rest of it. Full buffers are written as they fill up,
+ * the tail is padded to a block and the file is truncated by finish().
+ */
+template <typename KeyT, typename ValueT>
+class SnapshotWriter {
+    static_assert(std::is_trivially_copyable<KeyT>::value &&
+                      std::is_trivially_copyable<ValueT>::value,
+                  "Snapshot keys and values are copied bytewise");
+
+    using record_t = SnapshotRecord<KeyT, ValueT>;
+
+    static constexpr size_t kBlockSize  = detail::kSmallPageSize;
+    static constexpr size_t kBufferSize = size_t(1) << 20;
+
+  public:
+    explicit SnapshotWriter(const std::string& path)
+        : path_(path), buffer_(static_cast<char*>(std::aligned_alloc(kBlockSize, kBufferSize))) {
+        if (!buffer_) {
+            throw std::bad_alloc();
+        }
+        fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (fd_ < 0 && errno == EINVAL) {
+            // e.g. tmpfs
+            fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (fd_ < 0) {
+            throw detail::systemError("Can't open snapshot " + path);
+        }
+        auto header = SnapshotHeader::make<record_t>();
+        append(&header, sizeof(header));
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+
+    ~SnapshotWriter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void write(const KeyT& key, const ValueT& value) {
+        record_t record{key, value};
+        append(&record, sizeof(record));
+        count_++;
+    }
+
+    /// Writes out the buffered tail and closes the file
+    /// @return number of written records
+    size_t finish() {
+        size_t size = written_ + used_;
+        std::memset(buffer_.get() + used_, 0, detail::roundUp(used_, kBlockSize) - used_);
+        flush(detail::roundUp(used_, kBlockSize));
+        if (ftruncate(fd_, off_t(size)) != 0 || close(fd_) != 0) {
+            fd_ = -1;
+            throw detail::systemError("Can't write snapshot " + path_);
+        }
+        fd_ = -1;
+        return count_;
+    }
+
+  private:
+    void append(const void* data, size_t size) {
+        auto* bytes = static_cast<const char*>(data);
+        while (size) {
+            size_t chunk = std::min(size, kBufferSize - used_);
+            std::memcpy(buffer_.get() + used_, bytes, chunk);
+            used_ += chunk;
+            bytes += chunk;
+            size -= chunk;
+            if (used_ == kBufferSize) {
+                flush(kBufferSize);
+            }
+        }
+    }
+
+    /// Writes the first size bytes of the buffer, size is a multiple of kBlockSize
+    void flush(size_t size) {
+        for (size_t done = 0; done < size;) {
+            ssize_t res = ::write(fd_, buffer_.get() + done, size - done);
+            if (res < 0 && errno == EINTR) {
+                continue;
+            }
+            if (res <= 0) {
+                throw detail::systemError("Can't write snapshot " + path_);
+            }
+            done += size_t(res);
+        }
+        written_ += used_;
+        used_ = 0;
+    }
+
+    struct FreeDeleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+
+    std::string                        path_;
+    std::unique_ptr<char, FreeDeleter> buffer_;
+    int                                fd_      = -1;
+    size_t                             used_    = 0; ///< buffered bytes
+    size_t                             written_ = 0; ///< bytes in the file, without padding
+    size_t                             count_   = 0;
+};
+
+/**
+ * # SnapshotReader
+ * Maps a snapshot file and checks that it matches the record layout.
+ * Records are read in place, the mapping is advised for a sequential scan.
+ */
+template <typename KeyT, typename ValueT>
+class SnapshotReader {
+  public:
+    using record_t = SnapshotRecord<KeyT, ValueT>;
+
+    explicit SnapshotReader(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw detail::systemError("Can't open snapshot " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw detail::systemError("Can't read snapshot " + path);
+        }
+        size_ = size_t(st.st_size);
+        if (size_ < sizeof(SnapshotHeader) ||
+            (size_ - sizeof(SnapshotHeader)) % sizeof(record_t) != 0) {
+            close(fd);
+            throw std::runtime_error("Broken snapshot " + path);
+        }
+
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw detail::systemError("Can't map snapshot " + path);
+        }
+        madvise(data_, size_, MADV_SEQUENTIAL);
+        madvise(data_, size_, MADV_WILLNEED);
+
+        if (!SnapshotHeader::make<record_t>().matches(*static_cast<SnapshotHeader*>(data_))) {
+            munmap(data_, size_);
+            data_ = nullptr;
+            throw std::runtime_error("Snapshot " + path + " has another format or record layout");
+        }
+    }
+
+    SnapshotReader(const SnapshotReader&) = delete;
+
+    ~SnapshotReader() {
+        if (data_) {
+            munmap(data_, size_);
+        }
+    }
+
+    size_t size() const { return size_t(end() - begin()); }
+
+    const record_t* begin() const {
+        return reinterpret_cast<const record_t*>(static_cast<const char*>(data_) +
+                                                 sizeof(SnapshotHeader));
+    }
+
+    const record_t* end() const {
+        return reinterpret_cast<const record_t*>(static_cast<const char*>(data_) + size_);
+    }
+
+  private:
+    void*  data_ = nullptr;
+    size_t size_ = 0;
+};
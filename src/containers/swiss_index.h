@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__)
+#    include <immintrin.h>
+#endif
+
+#include "containers/node_array.h"
+#include "utility.h"
+
+/**
+ * # SwissIndex
+ * Open addressing hash index in the style of Swiss tables.
+ * It maps key hashes to node indices of a container-owned node array,
+ * keys are compared by the container through a callback.
+ *
+ * Slots are organized into groups of 16. Each slot has a control byte:
+ *   - kEmpty (0x80) for an unused slot
+ *   - 7 low bits of the hash (tag) for a used slot
+ * A key is placed into any slot of its probe window: kProbeGroups
+ * consecutive groups starting with the home group (hash >> 7).
+ * Control bytes of a window are compared with the tag at once
+ * (SSE2: a group per instruction, AVX2: the whole window),
+ * so a node is touched only when its tag matches.
+ *
+ * Windows never wrap: the table has kProbeGroups - 1 padding groups at the end.
+ * A window is always scanned completely, so an erased slot becomes empty
+ * immediately and no tombstones are needed. The price is that insertion
+ * fails when the whole window is occupied. The table is sized to keep
+ * load factor under maxLoadFactor(), which makes this rare (~1e-5 per insert);
+ * containers treat such an item as not cacheable.
+ *
+ * The arrays are NodeArrays, so NodePlacement applies to the index too.
+ * The index is not synchronized, see ConcurrentSwissIndex.
+ *
+ * @tparam IndexT unsigned or signed integer type of node indices
+ */
+template <typename IndexT>
+class SwissIndex {
+  public:
+    using index_t = IndexT;
+
+    static constexpr size_t  kGroupSize   = 16;
+    static constexpr size_t  kProbeGroups = 2;
+    static constexpr size_t  kWindowSize  = kGroupSize * kProbeGroups;
+    static constexpr int8_t  kEmpty       = int8_t(0x80);
+    static constexpr index_t npos         = std::numeric_limits<index_t>::max();
+
+    static_assert(kWindowSize <= 32, "Window match must fit into uint32_t");
+
+    static constexpr double maxLoadFactor() { return 0.5; }
+
+    /// Expected index memory per element, for the containers' elementSize()
+    static double bytesPerElement() {
+        return (sizeof(int8_t) + sizeof(index_t)) / maxLoadFactor();
+    }
+
+    static size_t groupCountForCapacity(size_t capacity) {
+        return std::max<size_t>(
+            bucketCountForLoadFactor(capacity, maxLoadFactor()) / kGroupSize, 1);
+    }
+
+    void allocate(size_t capacity) {
+        group_count_ = groupCountForCapacity(capacity);
+        group_mask_  = group_count_ - 1;
+
+        size_t slot_count = totalGroupCount() * kGroupSize;
+        ctrl_.allocate(slot_count);
+        std::memset(ctrl_.get(), kEmpty, slot_count);
+        slots_.allocate(slot_count);
+    }
+
+    void release() {
+        ctrl_.reset();
+        slots_.reset();
+        group_count_ = 0;
+        group_mask_  = 0;
+    }
+
+    size_t memoryUsage() const {
+        return totalGroupCount() * kGroupSize * (sizeof(int8_t) + sizeof(index_t));
+    }
+
+    size_t homeGroup(size_t hash) const { return (hash >> 7u) & group_mask_; }
+
+    /**
+     * @param hash
+     * @param eq returns true if a node with the given index holds the searched key
+     * @return node index or npos
+     */
+    template <typename KeyEq>
+    index_t find(size_t hash, const KeyEq& eq) const {
+        size_t   first = windowStart(hash);
+        uint32_t match = matchWindow(first, tag(hash));
+
+        while (match) {
+            size_t slot = first + __builtin_ctz(match);
+            if (eq(slots_[slot])) {
+                return slots_[slot];
+            }
+            match &= match - 1;
+        }
+
+        return npos;
+    }
+
+    /**
+     * Fails if the key is already present or the probe window is full.
+     */
+    template <typename KeyEq>
+    bool insert(size_t hash, index_t idx, const KeyEq& eq) {
+        if (find(hash, eq) != npos) {
+            return false;
+        }
+
+        size_t   first = windowStart(hash);
+        uint32_t empty = matchWindow(first, kEmpty);
+        if (!empty) {
+            return false;
+        }
+
+        size_t slot  = first + __builtin_ctz(empty);
+        ctrl_[slot]  = tag(hash);
+        slots_[slot] = idx;
+        return true;
+    }
+
+    /**
+     * Fails if the node index is not in the probe window.
+     */
+    bool erase(size_t hash, index_t idx) {
+        size_t   first = windowStart(hash);
+        uint32_t match = matchWindow(first, tag(hash));
+
+        while (match) {
+            size_t slot = first + __builtin_ctz(match);
+            if (slots_[slot] == idx) {
+                ctrl_[slot] = kEmpty;
+                return true;
+            }
+            match &= match - 1;
+        }
+
+        return false;
+    }
+
+    template <typename Callback>
+    void forEach(const Callback& callback) const {
+        for (size_t slot = 0; slot < totalGroupCount() * kGroupSize; slot++) {
+            if (ctrl_[slot] != kEmpty) {
+                callback(slots_[slot]);
+            }
+        }
+    }
+
+  protected:
+    size_t totalGroupCount() const {
+        return group_count_ ? group_count_ + kProbeGroups - 1 : 0;
+    }
+
+    static int8_t tag(size_t hash) { return int8_t(hash & 0x7fu); }
+
+    size_t windowStart(size_t hash) const { return homeGroup(hash) * kGroupSize; }
+
+    /// Bit i is set if control byte i of the window is equal to value
+    uint32_t matchWindow(size_t first, int8_t value) const {
+#if defined(__AVX2__)
+        static_assert(kWindowSize == 32, "AVX2 match expects a 32 byte window");
+        __m256i ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&ctrl_[first]));
+        return uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(value))));
+#elif defined(__SSE2__)
+        uint32_t res = 0;
+        for (size_t g = 0; g < kProbeGroups; g++) {
+            __m128i ctrl = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(&ctrl_[first + g * kGroupSize]));
+            res |= uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))))
+                   << (g * kGroupSize);
+        }
+        return res;
+#else
+        uint32_t res = 0;
+        for (size_t i = 0; i < kWindowSize; i++) {
+            res |= uint32_t(ctrl_[first + i] == value) << i;
+        }
+        return res;
+#endif
+    }
+
+    NodeArray<int8_t>  ctrl_;
+    NodeArray<index_t> slots_;
+
+    size_t group_count_ = 0;
+    size_t group_mask_  = 0;
+};
+
+/**
+ * SwissIndex with a lock per group.
+ *
+ * All accesses to a key go through its probe window,
+ * so a window is locked as a whole: its groups are locked in increasing order,
+ * which is the same for all threads and prevents deadlocks between overlapping windows.
+ *
+ * @tparam LockT see ContainerConfig::locking_t
+ */
+template <typename IndexT, typename LockT>
+class ConcurrentSwissIndex : public SwissIndex<IndexT> {
+    using base_t = SwissIndex<IndexT>;
+
+  public:
+    void allocate(size_t capacity) {
+        base_t::allocate(capacity);
+        locks_.allocate(this->totalGroupCount());
+    }
+
+    void release() {
+        base_t::release();
+        locks_.reset();
+    }
+
+    size_t memoryUsage() const {
+        return base_t::memoryUsage() + this->totalGroupCount() * sizeof(LockT);
+    }
+
+    /// Number of group locks, windows overlap so it is a bit larger than the group count
+    size_t lockCount() const { return this->totalGroupCount(); }
+
+    void lockWindow(size_t home_group) {
+        lockWindow(home_group, [](LockT& lock) { lock.lock(); });
+    }
+
+    /// Locks the window with lock_fn(LockT&), e.g. through a LockProfiler
+    template <typename LockFn>
+    void lockWindow(size_t home_group, const LockFn& lock_fn) {
+        for (size_t i = 0; i < base_t::kProbeGroups; i++) {
+            lock_fn(locks_[home_group + i]);
+        }
+    }
+
+    void unlockWindow(size_t home_group) {
+        unlockWindow(home_group, [](LockT& lock) { lock.unlock(); });
+    }
+
+    template <typename UnlockFn>
+    void unlockWindow(size_t home_group, const UnlockFn& unlock_fn) {
+        for (size_t i = base_t::kProbeGroups; i > 0; i--) {
+            unlock_fn(locks_[home_group + i - 1]);
+        }
+    }
+
+  private:
+    NodeArray<LockT> locks_;
+};
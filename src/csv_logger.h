@@ -5,6 +5,7 @@
 #include <string>
 
 #include "key_generator.h"
+#include "perf_counters.h"
 
 class CsvLogger {
   public:
@@ -23,7 +24,9 @@ class CsvLogger {
     void log(const std::string& run_name, const std::string& run_tag, unsigned threads,
              int payload_level, const KeyGenerator::ptr_t& gen, Container& cont, size_t iterations,
              size_t hits, std::chrono::duration<double> duration, float pull_threshold,
-             float purge_threshold, uint64_t unique_count, bool log_to_console = true,
+             float purge_threshold, uint64_t unique_count, const std::string& lock,
+             const std::string& promotion, const std::string& topology,
+             const PerfCounts& hw_counters, bool log_to_console = true,
              std::ostream* out = nullptr) {
         if (out == nullptr) {
             out = &output_;
@@ -55,15 +58,22 @@ class CsvLogger {
              //perf.head_accesses << ", " <<
              //payload_level << ", " <<
              pull_threshold << ", " <<
-             purge_threshold << "\n";
+             purge_threshold << ", " <<
+             lock << ", " <<
+             promotion << ", " <<
+             topology << ", ";
         // clang-format on
+        hw_counters.printPerOp(*out, iterations);
+        *out << "\n";
         if (log_to_console) {
             if (verbose_) {
                 verbose_log(run_name, run_tag, threads, payload_level, gen, cont, iterations, hits,
-                            duration, pull_threshold, purge_threshold, unique_count, &std::cout);
+                            duration, pull_threshold, purge_threshold, unique_count, lock,
+                            promotion, topology, hw_counters, &std::cout);
             } else {
                 log(run_name, run_tag, threads, payload_level, gen, cont, iterations, hits,
-                    duration, pull_threshold, purge_threshold, unique_count, false, &std::cout);
+                    duration, pull_threshold, purge_threshold, unique_count, lock, promotion,
+                    topology, hw_counters, false, &std::cout);
             }
         }
     }
@@ -82,8 +92,10 @@ class CsvLogger {
                   //"overhead_per_elem, "
                   //"find, insert, evict, head_access, "
                   //"payload_level, "
-                  "pull_threshold, purge_threshold"
-                  "\n";
+                  "pull_threshold, purge_threshold, "
+                  "lock, promotion, topology, ";
+        PerfCounts::printHeader(stream);
+        stream << "\n";
     }
 
     template <typename Container>
@@ -91,6 +103,8 @@ class CsvLogger {
                      int payload_level, const KeyGenerator::ptr_t& gen, Container& cont,
                      size_t iterations, size_t hits, std::chrono::duration<double> duration,
                      float pull_threshold, float purge_threshold, uint64_t unique_count,
+                     const std::string& lock, const std::string& promotion,
+                     const std::string& topology, const PerfCounts& hw_counters,
                      std::ostream* out = nullptr) {
         const char* spacer = "     ";
         if (out == nullptr) {
@@ -117,6 +131,9 @@ class CsvLogger {
         }
         *out << "Thresholds:                " << spacer << pull_threshold << "/" << purge_threshold
              << "\n";
+        *out << "Lock:                      " << spacer << lock << "\n";
+        *out << "Promotion:                 " << spacer << promotion << "\n";
+        *out << "Pinning/topology:          " << spacer << topology << "\n";
         //*out << "F/I/E/HA/HR:               " << spacer << (perf.find - perf.insert) / threads <<
         //"/"
         //     << perf.insert / threads << "/" << perf.evict / threads << "/"
@@ -124,6 +141,9 @@ class CsvLogger {
         //     << "%\n";
         *out << "Thread throughput:         " << spacer << thread_throughput / 1000 << " kOp/s\n";
         *out << "Hit rate:                  " << spacer << double(hits) / iterations * 100 << "%\n";
+        *out << "HW counters per op:        " << spacer;
+        hw_counters.printSummary(*out, iterations);
+        *out << "\n";
     }
 
     std::string  filename_;
@@ -147,7 +167,8 @@ class TraceCsvLogger {
     template <typename Container>
     void log(const std::string& run_name, const std::string& trace_name, Container& cont,
              size_t item_count, size_t iterations, std::chrono::duration<double> duration,
-             float pull, float purge, bool log_to_console = true, std::ostream* out = nullptr) {
+             float pull, float purge, const std::string& promotion, const PerfCounts& hw_counters,
+             bool log_to_console = true, std::ostream* out = nullptr) {
         if (out == nullptr) {
             out = &output_;
         }
@@ -169,15 +190,18 @@ class TraceCsvLogger {
              perf.insert << ", " <<
              perf.evict << ", " <<
              perf.head_accesses << ", " <<
-             pull << ", " << purge << "\n";
+             pull << ", " << purge << ", " <<
+             promotion << ", ";
         // clang-format on
+        hw_counters.printPerOp(*out, perf.find);
+        *out << "\n";
         if (log_to_console) {
             if (verbose_) {
                 verbose_log(run_name, trace_name, cont, item_count, iterations, duration,
-                            &std::cout);
+                            hw_counters, &std::cout);
             } else {
                 log(run_name, trace_name, cont, item_count, iterations, duration, pull, purge,
-                    false, &std::cout);
+                    promotion, hw_counters, false, &std::cout);
             }
         }
     }
@@ -187,13 +211,15 @@ class TraceCsvLogger {
         stream << "trace_name, container, capacity, "
                   "items, accesses, hits, hit_rate, "
                   "duration, throughput,"
-                  "insert, evict, head_access, pull_threshold, purge_threshold\n";
+                  "insert, evict, head_access, pull_threshold, purge_threshold, promotion, ";
+        PerfCounts::printHeader(stream);
+        stream << "\n";
     }
 
     template <typename Container>
     void verbose_log(const std::string& run_name, const std::string& trace_name, Container& cont,
                      size_t item_count, size_t iterations, std::chrono::duration<double> duration,
-                     std::ostream* out = nullptr) {
+                     const PerfCounts& hw_counters, std::ostream* out = nullptr) {
         const char* spacer = "     ";
         if (out == nullptr) {
             out = &output_;
@@ -210,6 +236,9 @@ class TraceCsvLogger {
         *out << "Hits:               " << spacer << (perf.find - perf.insert) << " ("
              << (perf.find - perf.insert) * 100. / perf.find << "%)\n";
         *out << "Duration:           " << spacer << duration.count() << " s\n";
+        *out << "HW counters per op: " << spacer;
+        hw_counters.printSummary(*out, perf.find);
+        *out << "\n";
     }
 
     std::string  filename_;
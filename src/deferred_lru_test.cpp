@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <omp.h>
+#include <stdexcept>
+#include <vector>
+
+#include "common.h"
+#include "containers/bucketed_adapter.h"
+#include "containers/deferred_lru.h"
+
+using config_t =
+    ContainerConfig<lru_key_t, lru_value_t, std::hash<lru_key_t>, std::less<>, OpenMPLock>;
+
+/**
+ * Looks up a skewed key stream. Hot keys are marked recent over and over,
+ * so with several recent shards a node pulled from one shard is often found
+ * again in the next one, and the cold keys keep the purge running.
+ *
+ * @return number of lookups that returned a value of another key
+ */
+template <typename Container>
+size_t lookups(Container& cont, uint64_t seed, size_t count) {
+    size_t   wrong = 0;
+    uint64_t x     = 0x9E3779B97F4A7C15ull * (seed + 1);
+    for (size_t i = 0; i < count; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        lru_key_t   key = (x & 3) ? (x >> 8) % 256 : (x >> 8) % 20000;
+        lru_value_t value;
+        cont.consumeCachedOrCompute(key, [&] { return lru_value_t{{key, ~key}}; }, value);
+        wrong += value[0] != key || value[1] != ~key;
+    }
+    return wrong;
+}
+
+/// Runs lookups() on all threads
+/// @return true if every lookup returned the value of its key
+template <typename Container>
+bool stress(const char* name, Container& cont, int thread_count, size_t count) {
+    size_t wrong = 0;
+
+    #pragma omp parallel num_threads(thread_count) reduction(+ : wrong)
+    {
+        wrong += lookups(cont, omp_get_thread_num(), count);
+    }
+
+    std::cout << name << ": " << (wrong ? "FAILED" : "ok") << " (" << wrong << " wrong values in "
+              << count * thread_count << " lookups)" << std::endl;
+    return wrong == 0;
+}
+
+/**
+ * resize() grows the cache only into the node array reserved for NodePlacement::max_growth.
+ * Checks that growing beyond the reserve throws, and that within the reserve
+ * the cache keeps returning correct values while one thread resizes it back and forth.
+ */
+template <typename Container>
+bool resizeWhileRunning(const char* name, int thread_count, size_t count) {
+    const size_t capacity = 2000;
+    bool         ok       = true;
+
+    NodePlacement::global().max_growth = 1;
+    {
+        Container lru(capacity, true, 0.05, 0.1, 4);
+        ok &= lru.maxCapacity() == capacity;
+        try {
+            lru.resize(2 * capacity);
+            ok = false;
+        } catch (std::runtime_error&) {
+        }
+        // shrinking and growing back within the reserve works without max_growth
+        lru.resize(capacity / 2);
+        lru.resize(capacity);
+    }
+
+    NodePlacement::global().max_growth = 4;
+    Container lru(capacity, true, 0.05, 0.1, 4);
+    NodePlacement::global().max_growth = 1;
+    ok &= lru.maxCapacity() >= 4 * capacity;
+
+    std::atomic<int> running{thread_count - 1};
+    size_t           wrong   = 0;
+    size_t           resizes = 0;
+
+    #pragma omp parallel num_threads(thread_count) reduction(+ : wrong, resizes)
+    {
+        if (omp_get_thread_num() == 0) {
+            const size_t sizes[] = {4 * capacity, capacity / 4, 2 * capacity, capacity};
+            for (size_t i = 0; running.load() > 0 || i % 4 != 0; i++) {
+                lru.resize(sizes[i % 4]);
+                resizes++;
+            }
+        } else {
+            wrong += lookups(lru, omp_get_thread_num(), count);
+            running--;
+        }
+    }
+    ok &= wrong == 0;
+
+    std::cout << name << " resize: " << (ok ? "ok" : "FAILED") << " (" << wrong
+              << " wrong values, " << resizes << " resizes)" << std::endl;
+    return ok;
+}
+
+/**
+ * Fingerprints filter the slots of a bucket block, so they must not repeat the hash bits
+ * that chose the shard of an adapter. Counts distinct fingerprints of the keys
+ * that land in one shard of BucketedCompactDeferredLRU with 256 shards.
+ */
+bool fingerprintSpread() {
+    using shard_t = DeferredLRU<config_t, false, uint16_t>;
+
+    ShardSizing::global().shards = 256;
+    BucketedCompactDeferredLRU<config_t> lru(256 * 1024, true);
+    ShardSizing::global().shards = 0;
+
+    typename config_t::index_hasher_t hasher;
+    std::vector<bool>                 seen(256);
+    size_t                            keys = 0;
+    for (lru_key_t key = 0; keys < 4096; key++) {
+        if (lru.getBucketNr(key) == 0) {
+            seen[shard_t::fingerprint(hasher(key))] = true;
+            keys++;
+        }
+    }
+    size_t distinct = std::count(seen.begin(), seen.end(), true);
+
+    bool ok = lru.bucketCount() == 256 && distinct >= 240;
+    std::cout << "fingerprints: " << (ok ? "ok" : "FAILED") << " (" << distinct
+              << " distinct of 256 in one of " << lru.bucketCount() << " shards)" << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int    thread_count = argc > 1 ? std::atoi(argv[1]) : 8;
+    size_t count        = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+
+    const size_t capacity      = 2000;
+    const double pull_factor   = 0.05;
+    const double purge_factor  = 0.1;
+    const size_t recent_shards = 4;
+
+    bool ok = true;
+    {
+        DeferredLRU<config_t> lru(capacity, true, pull_factor, purge_factor, recent_shards);
+        ok &= stress("deferred", lru, thread_count, count);
+    }
+    {
+        DeferredLRU<config_t, false, uint32_t> lru(capacity, true, pull_factor, purge_factor,
+                                                   recent_shards);
+        ok &= stress("deferred_compact", lru, thread_count, count);
+    }
+    {
+        DeferredLRU<config_t, false, uint32_t, true> lru(capacity, true, pull_factor,
+                                                         purge_factor, recent_shards);
+        ok &= stress("deferred_soa", lru, thread_count, count);
+    }
+    {
+        DeferredLRU<config_t, false, uint16_t> lru(capacity, true, pull_factor, purge_factor,
+                                                   recent_shards);
+        ok &= stress("deferred_u16", lru, thread_count, count);
+    }
+    {
+        DeferredLRU<config_t, true, uint32_t> lru(capacity, true, pull_factor, purge_factor,
+                                                  recent_shards);
+        ok &= stress("deferred_swiss_compact", lru, thread_count, count);
+    }
+    {
+        BucketedCompactDeferredLRU<config_t> lru(capacity, true);
+        ok &= stress("b_deferred_compact", lru, thread_count, count);
+    }
+
+    ok &= fingerprintSpread();
+
+    ok &= resizeWhileRunning<DeferredLRU<config_t>>("deferred", thread_count, count);
+    ok &= resizeWhileRunning<DeferredLRU<config_t, false, uint32_t, true>>("deferred_soa",
+                                                                           thread_count, count);
+    ok &= resizeWhileRunning<DeferredLRU<config_t, true, uint32_t>>("deferred_swiss_compact",
+                                                                    thread_count, count);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#if __has_include("git_commit.h")
+#    include "git_commit.h"
+#endif
+#include "lock_profiler.h"
+#include "perf_counters.h"
+#include "topology.h"
+#include "utility.h"
+
+/**
+ * Flat builder of a JSON object, values are appended in the order of add() calls.
+ * Non-finite numbers are written as null.
+ */
+class JsonObject {
+  public:
+    JsonObject& add(const std::string& key, const std::string& value) {
+        return addRaw(key, quote(value));
+    }
+
+    JsonObject& add(const std::string& key, const char* value) {
+        return add(key, std::string(value));
+    }
+
+    JsonObject& add(const std::string& key, bool value) {
+        return addRaw(key, value ? "true" : "false");
+    }
+
+    JsonObject& add(const std::string& key, double value) {
+        if (!std::isfinite(value)) {
+            return addNull(key);
+        }
+        std::ostringstream out;
+        out.precision(12);
+        out << value;
+        return addRaw(key, out.str());
+    }
+
+    template <typename IntT,
+              typename = std::enable_if_t<std::is_integral<IntT>::value &&
+                                          !std::is_same<IntT, bool>::value>>
+    JsonObject& add(const std::string& key, IntT value) {
+        return addRaw(key, std::to_string(value));
+    }
+
+    JsonObject& add(const std::string& key, const JsonObject& value) {
+        return addRaw(key, value.str());
+    }
+
+    JsonObject& addNull(const std::string& key) { return addRaw(key, "null"); }
+
+    std::string str() const { return '{' + body_ + '}'; }
+
+    static std::string quote(const std::string& s) {
+        std::string res = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                res += '\\';
+                res += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                res += buf;
+            } else {
+                res += c;
+            }
+        }
+        return res + '"';
+    }
+
+  private:
+    JsonObject& addRaw(const std::string& key, const std::string& json) {
+        body_ += (body_.empty() ? "" : ", ") + quote(key) + ": " + json;
+        return *this;
+    }
+
+    std::string body_;
+};
+
+/**
+ * Host, build and CPU of the running benchmark, the same for every run of the process.
+ * The commit comes from git_commit.h, generated by CMake on every build,
+ * and the build type from LRU_BUILD_TYPE.
+ */
+inline JsonObject runEnvironment() {
+    JsonObject env;
+
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    env.add("host", host);
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        env.add("kernel", std::string(uts.sysname) + ' ' + uts.release).add("arch", uts.machine);
+    }
+
+#ifdef LRU_GIT_COMMIT
+    env.add("commit", LRU_GIT_COMMIT);
+#else
+    env.add("commit", "unknown");
+#endif
+#ifdef LRU_BUILD_TYPE
+    env.add("build_type", LRU_BUILD_TYPE);
+#else
+    env.add("build_type", "unknown");
+#endif
+    env.add("compiler", __VERSION__);
+#ifdef __OPTIMIZE__
+    env.add("optimized", true);
+#else
+    env.add("optimized", false);
+#endif
+#ifdef __AVX2__
+    env.add("avx2", true);
+#else
+    env.add("avx2", false);
+#endif
+
+    std::string   cpu_model;
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; std::getline(cpuinfo, line);) {
+        if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos) {
+            cpu_model = line.substr(line.find(':') + 2);
+            break;
+        }
+    }
+    const auto& topology = CpuTopology::get();
+    env.add("cpu_model", cpu_model)
+        .add("cpus", topology.cpus().size())
+        .add("cores", topology.coreCount())
+        .add("numa_nodes", topology.nodeCount());
+    return env;
+}
+
+/**
+ * # JsonLogger
+ * Appends one JSON object per run to a JSON lines file.
+ *
+ * Unlike the CSV loggers it keeps everything needed to reproduce and compare a run:
+ * the whole configuration of the harness, its results, the profile and memory
+ * statistics of the container, lock wait percentiles, hardware counters
+ * and the environment of the run.
+ */
+class JsonLogger {
+  public:
+    explicit JsonLogger(const std::string& filename)
+        : output_(filename, std::fstream::out | std::fstream::app) {
+        if (!output_.is_open()) {
+            throw std::runtime_error("Can't open JSON log file " + filename);
+        }
+    }
+
+    /// @param ops operations the hardware counters are divided by
+    template <typename Container>
+    void log(const std::string& harness, const JsonObject& config, const JsonObject& results,
+             const Container& cont, const LockProfileReport& locks, const PerfCounts& hw_counters,
+             size_t ops) {
+        JsonObject run;
+        run.add("harness", harness)
+            .add("timestamp", timestamp())
+            .add("container", cont.name())
+            .add("config", config)
+            .add("results", results)
+            .add("profile", profile(cont.profileStats()))
+            .add("mem", mem(cont.memStats()))
+            .add("lock_wait", lockWait(locks))
+            .add("perf_per_op", perf(hw_counters, ops))
+            .add("environment", runEnvironment());
+        output_ << run.str() << '\n';
+        output_.flush();
+    }
+
+  private:
+    static std::string timestamp() {
+        std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm     utc;
+        gmtime_r(&now, &utc);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        return buf;
+    }
+
+    static JsonObject profile(const ProfileStatsSlice& s) {
+        JsonObject res;
+        res.add("enabled", s.enabled)
+            .add("find", s.find)
+            .add("insert", s.insert)
+            .add("head_accesses", s.head_accesses)
+            .add("evict", s.evict);
+        return res;
+    }
+
+    static JsonObject mem(const MemStats& s) {
+        JsonObject res;
+        res.add("count", s.count)
+            .add("capacity", s.capacity)
+            .add("total_mem", s.total_mem)
+            .add("used_mem", s.used_mem)
+            .add("total_overhead_mem", s.total_overhead_mem);
+        return res;
+    }
+
+    /// Wait time percentiles of contended acquires per lock class, empty without --profile
+    static JsonObject lockWait(const LockProfileReport& report) {
+        JsonObject res;
+        if (!report.enabled) {
+            return res;
+        }
+        for (size_t c = 0; c < kLockClassCount; c++) {
+            const auto& s = report.classes[c];
+            if (!s.acquires && !s.failed_try_locks) {
+                continue;
+            }
+            JsonObject lock;
+            lock.add("acquires", s.acquires)
+                .add("contended", s.contended)
+                .add("failed_try_locks", s.failed_try_locks)
+                .add("retries", s.retries)
+                .add("spins", s.spins)
+                .add("p50_ns", s.waitQuantile(0.5))
+                .add("p90_ns", s.waitQuantile(0.9))
+                .add("p99_ns", s.waitQuantile(0.99));
+            res.add(LockProfileReport::className(c), lock);
+        }
+        return res;
+    }
+
+    static JsonObject perf(const PerfCounts& counts, size_t ops) {
+        JsonObject res;
+        for (int i = 0; i < kPerfEventCount; i++) {
+            if (counts.valid[i] && ops) {
+                res.add(PerfCounts::name(i), counts.values[i] / ops);
+            } else {
+                res.addNull(PerfCounts::name(i));
+            }
+        }
+        return res;
+    }
+
+    std::ofstream output_;
+};
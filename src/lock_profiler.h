@@ -0,0 +1,351 @@
+#pragma once
+
+#include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "utility.h"
+
+enum class LockClass {
+    Bucket, ///< hash table bucket or probe window locks
+    Node,   ///< per node locks of intrusive lists
+    Lru,    ///< LRU list maintenance lock
+    Global, ///< lock of the whole container
+    Count
+};
+
+constexpr size_t kLockClassCount  = size_t(LockClass::Count);
+constexpr size_t kLockWaitBuckets = 32;
+constexpr size_t kHotLockCount    = 10;
+constexpr size_t kNoLockIndex     = std::numeric_limits<size_t>::max();
+
+/// Time stamp counter on x86, about half the cost of a steady_clock read; nanoseconds elsewhere
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/// readCycleCounter() ticks per nanosecond, measured against steady_clock on the first call
+inline double cycleCounterTicksPerNs() {
+    static const double ticks_per_ns = [] {
+        auto     start = std::chrono::steady_clock::now();
+        uint64_t begin = readCycleCounter();
+        while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(10)) {
+        }
+        uint64_t end     = readCycleCounter();
+        auto     elapsed = std::chrono::steady_clock::now() - start;
+        return double(end - begin) / std::chrono::duration<double, std::nano>(elapsed).count();
+    }();
+    return ticks_per_ns;
+}
+
+struct LockClassStats {
+    uint64_t acquires;
+    uint64_t contended;        ///< acquires that waited longer than an uncontended one
+    uint64_t failed_try_locks; ///< try_lock calls of the algorithm that failed
+    uint64_t retries;          ///< restarts of an operation because a locked state changed
+    uint64_t spins;            ///< backoff iterations while waiting for another thread
+    /// contended acquires by wait time, bucket i counts waits in [2^i, 2^(i+1)) ns
+    std::array<uint64_t, kLockWaitBuckets> wait_ns_histogram;
+
+    /// Approximate wait time quantile of contended acquires, upper bound of its bucket
+    uint64_t waitQuantile(double q) const {
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kLockWaitBuckets; i++) {
+            seen += wait_ns_histogram[i];
+            if (contended && seen >= q * contended) {
+                return uint64_t(2) << i;
+            }
+        }
+        return 0;
+    }
+};
+
+struct HotLock {
+    size_t   shard;
+    size_t   index;
+    uint64_t contended;
+};
+
+/**
+ * Snapshot of a LockProfiler, can be merged over shards of an adapter.
+ */
+struct LockProfileReport {
+    bool                                        enabled = false;
+    std::array<LockClassStats, kLockClassCount> classes{};
+    std::vector<HotLock>                        hot_buckets;
+
+    static const char* className(size_t c) {
+        static const char* names[] = {"bucket", "node", "lru", "global"};
+        return names[c];
+    }
+
+    void merge(const LockProfileReport& other, size_t shard) {
+        enabled = enabled || other.enabled;
+        for (size_t c = 0; c < kLockClassCount; c++) {
+            auto&       dst = classes[c];
+            const auto& src = other.classes[c];
+            dst.acquires += src.acquires;
+            dst.contended += src.contended;
+            dst.failed_try_locks += src.failed_try_locks;
+            dst.retries += src.retries;
+            dst.spins += src.spins;
+            for (size_t i = 0; i < kLockWaitBuckets; i++) {
+                dst.wait_ns_histogram[i] += src.wait_ns_histogram[i];
+            }
+        }
+        for (auto hot : other.hot_buckets) {
+            hot.shard = shard;
+            hot_buckets.push_back(hot);
+        }
+        std::sort(hot_buckets.begin(), hot_buckets.end(),
+                  [](const HotLock& a, const HotLock& b) { return a.contended > b.contended; });
+        if (hot_buckets.size() > kHotLockCount) {
+            hot_buckets.resize(kHotLockCount);
+        }
+    }
+
+    void print(std::ostream& out, const char* prefix = "") const {
+        if (!enabled) {
+            return;
+        }
+        for (size_t c = 0; c < kLockClassCount; c++) {
+            const auto& s = classes[c];
+            if (!s.acquires && !s.failed_try_locks && !s.retries && !s.spins) {
+                continue;
+            }
+            out << prefix << className(c) << " locks: acquires " << s.acquires << ", contended "
+                << s.contended << ' ' << prettyPrintRatio(s.contended, s.acquires)
+                << ", failed try_lock " << s.failed_try_locks << ", retries " << s.retries
+                << ", spins " << s.spins << ", wait p50/p99 " << s.waitQuantile(0.5) << "/"
+                << s.waitQuantile(0.99) << " ns\n";
+        }
+        if (!hot_buckets.empty()) {
+            out << prefix << "hottest buckets (shard:index=contended):";
+            for (const auto& hot : hot_buckets) {
+                out << ' ' << hot.shard << ':' << hot.index << '=' << hot.contended;
+            }
+            out << '\n';
+        }
+    }
+};
+
+/**
+ * # LockProfiler
+ * Contention profiler for container locks, enabled by ContainerConfig::enable_profile.
+ *
+ * Every acquire is a single lock() call timed with the cycle counter, so fair locks
+ * (ticket, MCS) keep their queue order, and an acquire that waited longer than an
+ * uncontended one could take (kContendedWaitNs) is counted as contended.
+ * Counters are striped by OpenMP thread number and incremented
+ * without read-modify-write, so they may lose increments if stripes are shared.
+ * Contention of bucket locks is also counted per bucket index to expose hash skew.
+ *
+ * The disabled profiler forwards to the lock and compiles to nothing else.
+ */
+template <bool Enable>
+class LockProfiler {
+  public:
+    template <typename LockT>
+    void lock(LockClass, LockT& l, size_t = kNoLockIndex) {
+        l.lock();
+    }
+
+    template <typename LockT>
+    void lockShared(LockClass, LockT& l, size_t = kNoLockIndex) {
+        l.lock_shared();
+    }
+
+    template <typename LockT>
+    bool tryLock(LockClass, LockT& l) {
+        return l.try_lock();
+    }
+
+    void retry(LockClass) {}
+
+    void spin(LockClass) {}
+
+    void trackBuckets(size_t) {}
+
+    void reset() {}
+
+    LockProfileReport report() const { return {}; }
+};
+
+template <>
+class LockProfiler<true> {
+    using counter_t = std::atomic<uint64_t>;
+
+    struct ClassCounters {
+        counter_t                               acquires;
+        counter_t                               contended;
+        counter_t                               failed_try_locks;
+        counter_t                               retries;
+        counter_t                               spins;
+        std::array<counter_t, kLockWaitBuckets> wait_ns_histogram;
+    };
+
+    struct CACHELINE_ALIGN Stripe {
+        std::array<ClassCounters, kLockClassCount> classes;
+    };
+
+    static constexpr size_t kStripes = 64;
+
+    /// Above an uncontended acquire that misses the cache on the lock, measured at 200-500 ns
+    static constexpr int64_t kContendedWaitNs = 512;
+
+  public:
+    LockProfiler()
+        : stripes_(new Stripe[kStripes]),
+          ticks_per_ns_(cycleCounterTicksPerNs()),
+          contended_ticks_(uint64_t(kContendedWaitNs * ticks_per_ns_)) {
+        reset();
+    }
+
+    template <typename LockT>
+    void lock(LockClass c, LockT& l, size_t index = kNoLockIndex) {
+        acquire(c, index, [&l] { l.lock(); });
+    }
+
+    /// Shared mode acquire, counted together with exclusive ones of the class
+    template <typename LockT>
+    void lockShared(LockClass c, LockT& l, size_t index = kNoLockIndex) {
+        acquire(c, index, [&l] { l.lock_shared(); });
+    }
+
+    template <typename LockT>
+    bool tryLock(LockClass c, LockT& l) {
+        auto& counters = local(c);
+        if (l.try_lock()) {
+            bump(counters.acquires);
+            return true;
+        }
+        bump(counters.failed_try_locks);
+        return false;
+    }
+
+    void retry(LockClass c) { bump(local(c).retries); }
+
+    void spin(LockClass c) { bump(local(c).spins); }
+
+    /// Enables per index contention counting for bucket_count bucket locks
+    void trackBuckets(size_t bucket_count) {
+        bucket_count_ = bucket_count;
+        bucket_contention_.reset(bucket_count ? new std::atomic<uint32_t>[bucket_count] : nullptr);
+        for (size_t i = 0; i < bucket_count_; i++) {
+            bucket_contention_[i] = 0;
+        }
+    }
+
+    void reset() {
+        for (size_t s = 0; s < kStripes; s++) {
+            for (auto& counters : stripes_[s].classes) {
+                counters.acquires         = 0;
+                counters.contended        = 0;
+                counters.failed_try_locks = 0;
+                counters.retries          = 0;
+                counters.spins            = 0;
+                for (auto& bucket : counters.wait_ns_histogram) {
+                    bucket = 0;
+                }
+            }
+        }
+        for (size_t i = 0; i < bucket_count_; i++) {
+            bucket_contention_[i] = 0;
+        }
+    }
+
+    LockProfileReport report() const {
+        LockProfileReport res;
+        res.enabled = true;
+        for (size_t s = 0; s < kStripes; s++) {
+            for (size_t c = 0; c < kLockClassCount; c++) {
+                const auto& src = stripes_[s].classes[c];
+                auto&       dst = res.classes[c];
+                dst.acquires += src.acquires.load(std::memory_order_relaxed);
+                dst.contended += src.contended.load(std::memory_order_relaxed);
+                dst.failed_try_locks += src.failed_try_locks.load(std::memory_order_relaxed);
+                dst.retries += src.retries.load(std::memory_order_relaxed);
+                dst.spins += src.spins.load(std::memory_order_relaxed);
+                for (size_t i = 0; i < kLockWaitBuckets; i++) {
+                    dst.wait_ns_histogram[i] +=
+                        src.wait_ns_histogram[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < bucket_count_; i++) {
+            uint32_t contended = bucket_contention_[i].load(std::memory_order_relaxed);
+            if (contended) {
+                res.hot_buckets.push_back({0, i, contended});
+            }
+        }
+        auto hot_end = res.hot_buckets.begin() +
+                       std::min<size_t>(res.hot_buckets.size(), kHotLockCount);
+        std::partial_sort(
+            res.hot_buckets.begin(), hot_end, res.hot_buckets.end(),
+            [](const HotLock& a, const HotLock& b) { return a.contended > b.contended; });
+        res.hot_buckets.erase(hot_end, res.hot_buckets.end());
+        return res;
+    }
+
+  private:
+    template <typename LockFn>
+    void acquire(LockClass c, size_t index, const LockFn& lock) {
+        auto& counters = local(c);
+        bump(counters.acquires);
+
+        uint64_t start = readCycleCounter();
+        lock();
+        uint64_t wait = readCycleCounter() - start;
+        if (wait <= contended_ticks_) {
+            return;
+        }
+        bump(counters.contended);
+        bump(counters.wait_ns_histogram[waitBucket(uint64_t(double(wait) / ticks_per_ns_))]);
+        if (c == LockClass::Bucket && index < bucket_count_) {
+            bucket_contention_[index].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ClassCounters& local(LockClass c) {
+        return stripes_[size_t(omp_get_thread_num()) % kStripes].classes[size_t(c)];
+    }
+
+    /// Increment without a locked instruction, the stripe is normally owned by one thread
+    static void bump(counter_t& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static size_t waitBucket(uint64_t ns) {
+        size_t bucket = 0;
+        while (ns > 1 && bucket + 1 < kLockWaitBuckets) {
+            ns >>= 1u;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    std::unique_ptr<Stripe[]>                stripes_;
+    double                                   ticks_per_ns_;
+    uint64_t                                 contended_ticks_;
+    size_t                                   bucket_count_ = 0;
+    std::unique_ptr<std::atomic<uint32_t>[]> bucket_contention_;
+};
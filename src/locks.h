@@ -0,0 +1,554 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "utility.h"
+
+/*
+ * Lock types for ContainerConfig::locking_t, alternatives to OpenMPLock.
+ *
+ * Spinning locks yield the CPU once their backoff reaches its limit,
+ * so they stay usable when threads are oversubscribed.
+ */
+
+/// Tells the CPU that the thread is busy waiting
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * Exponential backoff for busy waiting: the number of pauses doubles
+ * with every call, after kMaxPauses the thread yields instead.
+ */
+class SpinBackoff {
+  public:
+    void wait() {
+        if (pauses_ >= kMaxPauses) {
+            std::this_thread::yield();
+            return;
+        }
+        for (uint32_t i = 0; i < pauses_; i++) {
+            cpuRelax();
+        }
+        pauses_ <<= 1u;
+    }
+
+  private:
+    static constexpr uint32_t kMaxPauses = 1024;
+
+    uint32_t pauses_ = 1;
+};
+
+/**
+ * # BasicTTASLock
+ * Test-and-test-and-set spinlock with exponential backoff.
+ * Waiters spin on a plain load, so they don't steal the cache line from the holder.
+ *
+ * @tparam WordT lock word, uint8_t gives a 1-byte lock that fits
+ *               next to other fields of a bucket header
+ */
+template <typename WordT>
+class BasicTTASLock {
+  public:
+    void lock() {
+        SpinBackoff backoff;
+        while (word_.exchange(1, std::memory_order_acquire)) {
+            while (word_.load(std::memory_order_relaxed)) {
+                backoff.wait();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !word_.load(std::memory_order_relaxed) &&
+               !word_.exchange(1, std::memory_order_acquire);
+    }
+
+    void unlock() { word_.store(0, std::memory_order_release); }
+
+  private:
+    std::atomic<WordT> word_{0};
+};
+
+using TTASLock = BasicTTASLock<uint32_t>;
+using ByteLock = BasicTTASLock<uint8_t>;
+
+static_assert(sizeof(ByteLock) == 1, "ByteLock must occupy a single byte");
+
+/**
+ * # TicketLock
+ * FIFO spinlock. The low half of the word is the ticket being served,
+ * the high half is the next ticket, so try_lock is a single CAS.
+ * Waiters back off proportionally to their distance from the head of the queue.
+ */
+class TicketLock {
+  public:
+    void lock() {
+        uint32_t prev   = word_.fetch_add(kNextTicket, std::memory_order_relaxed);
+        auto     ticket = uint16_t(prev >> 16u);
+        uint32_t rounds = 0;
+        while (true) {
+            auto serving = uint16_t(word_.load(std::memory_order_acquire));
+            if (serving == ticket) {
+                return;
+            }
+            if (++rounds > kMaxRounds) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < uint16_t(ticket - serving) * kPausesPerWaiter; i++) {
+                cpuRelax();
+            }
+        }
+    }
+
+    bool try_lock() {
+        uint32_t word = word_.load(std::memory_order_relaxed);
+        if (uint16_t(word) != uint16_t(word >> 16u)) {
+            return false;
+        }
+        return word_.compare_exchange_strong(word, word + kNextTicket, std::memory_order_acquire,
+                                             std::memory_order_relaxed);
+    }
+
+    void unlock() {
+        // The serving half must wrap around without carrying into the next ticket
+        uint32_t word = word_.load(std::memory_order_relaxed);
+        while (!word_.compare_exchange_weak(word, (word & 0xffff0000u) | uint16_t(word + 1),
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+  private:
+    static constexpr uint32_t kNextTicket      = 1u << 16u;
+    static constexpr uint32_t kPausesPerWaiter = 64;
+    static constexpr uint32_t kMaxRounds       = 16;
+
+    std::atomic<uint32_t> word_{0};
+};
+
+/**
+ * # MCSLock
+ * Queue lock, every waiter spins on its own cache line.
+ *
+ * lock()/unlock() take no arguments, so queue nodes come from a small
+ * per-thread pool and the holder keeps its node in the lock.
+ * A thread can hold up to kMaxHeldLocks MCS locks at once.
+ */
+class MCSLock {
+    struct CACHELINE_ALIGN QNode {
+        std::atomic<QNode*> next{nullptr};
+        std::atomic<bool>   waiting{false};
+    };
+
+    static constexpr size_t kMaxHeldLocks = 16;
+
+    class NodePool {
+      public:
+        NodePool() {
+            for (size_t i = 0; i < kMaxHeldLocks; i++) {
+                free_[i] = &nodes_[i];
+            }
+        }
+
+        QNode* acquire() {
+            if (free_count_ == 0) {
+                throw std::runtime_error("Thread holds too many MCS locks");
+            }
+            return free_[--free_count_];
+        }
+
+        void release(QNode* node) { free_[free_count_++] = node; }
+
+      private:
+        QNode  nodes_[kMaxHeldLocks];
+        QNode* free_[kMaxHeldLocks];
+        size_t free_count_ = kMaxHeldLocks;
+    };
+
+    static NodePool& pool() {
+        thread_local NodePool pool;
+        return pool;
+    }
+
+  public:
+    void lock() {
+        QNode* node = pool().acquire();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->waiting.store(true, std::memory_order_relaxed);
+
+        QNode* prev = tail_.exchange(node, std::memory_order_acq_rel);
+        if (prev) {
+            prev->next.store(node, std::memory_order_release);
+            SpinBackoff backoff;
+            while (node->waiting.load(std::memory_order_acquire)) {
+                backoff.wait();
+            }
+        }
+        owner_ = node;
+    }
+
+    bool try_lock() {
+        QNode* node = pool().acquire();
+        node->next.store(nullptr, std::memory_order_relaxed);
+
+        QNode* expected = nullptr;
+        if (tail_.compare_exchange_strong(expected, node, std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+            owner_ = node;
+            return true;
+        }
+        pool().release(node);
+        return false;
+    }
+
+    void unlock() {
+        QNode* node = owner_;
+        QNode* next = node->next.load(std::memory_order_acquire);
+        if (!next) {
+            QNode* expected = node;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+                pool().release(node);
+                return;
+            }
+            // A successor has swapped the tail but has not linked itself yet
+            SpinBackoff backoff;
+            while (!(next = node->next.load(std::memory_order_acquire))) {
+                backoff.wait();
+            }
+        }
+        next->waiting.store(false, std::memory_order_release);
+        pool().release(node);
+    }
+
+  private:
+    std::atomic<QNode*> tail_{nullptr};
+    QNode*              owner_ = nullptr; ///< node of the holder, accessed by the holder only
+};
+
+/**
+ * # FutexLock
+ * Adaptive mutex: spins while the lock is held without waiters
+ * and sleeps on a futex after that (Drepper, "Futexes Are Tricky", mutex 2).
+ * State is 0 unlocked, 1 locked, 2 locked with possible sleepers,
+ * unlock enters the kernel only in state 2.
+ */
+class FutexLock {
+  public:
+    void lock() {
+        uint32_t state = 0;
+        for (uint32_t i = 0; i < kSpinCount; i++) {
+            if (state == 0 && state_.compare_exchange_weak(state, 1, std::memory_order_acquire,
+                                                           std::memory_order_relaxed)) {
+                return;
+            }
+            if (state == 2) {
+                break;
+            }
+            cpuRelax();
+            state = state_.load(std::memory_order_relaxed);
+        }
+
+        state = state_.exchange(2, std::memory_order_acquire);
+        while (state != 0) {
+            futex(FUTEX_WAIT_PRIVATE, 2);
+            state = state_.exchange(2, std::memory_order_acquire);
+        }
+    }
+
+    bool try_lock() {
+        uint32_t state = 0;
+        return state_.compare_exchange_strong(state, 1, std::memory_order_acquire,
+                                              std::memory_order_relaxed);
+    }
+
+    void unlock() {
+        if (state_.exchange(0, std::memory_order_release) == 2) {
+            futex(FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+
+  private:
+    static constexpr uint32_t kSpinCount = 100;
+
+    void futex(int op, uint32_t value) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_), op, value, nullptr, nullptr, 0);
+    }
+
+    std::atomic<uint32_t> state_{0};
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "Futex word must be a plain 32-bit integer");
+};
+
+/// Locks with shared mode: lock_shared(), try_lock_shared() and unlock_shared()
+template <typename LockT, typename = void>
+struct SupportsSharedLock : std::false_type {};
+
+template <typename LockT>
+struct SupportsSharedLock<LockT, std::void_t<decltype(std::declval<LockT&>().lock_shared()),
+                                             decltype(std::declval<LockT&>().try_lock_shared()),
+                                             decltype(std::declval<LockT&>().unlock_shared())>>
+    : std::true_type {};
+
+/**
+ * # RWSpinLock
+ * Reader-writer spinlock in a single word: a writer bit, a writer pending bit
+ * that stops new readers so writers are not starved, and the reader count.
+ * All readers update the same word, so shared acquires still bounce its cache line.
+ */
+class RWSpinLock {
+  public:
+    void lock() {
+        SpinBackoff backoff;
+        while (true) {
+            uint32_t word = word_.load(std::memory_order_relaxed);
+            if ((word & ~kPending) == 0) {
+                if (word_.compare_exchange_weak(word, kWriter, std::memory_order_acquire,
+                                                std::memory_order_relaxed)) {
+                    return;
+                }
+                continue;
+            }
+            if (!(word & kPending)) {
+                word_.fetch_or(kPending, std::memory_order_relaxed);
+            }
+            backoff.wait();
+        }
+    }
+
+    bool try_lock() {
+        uint32_t word = word_.load(std::memory_order_relaxed);
+        return (word & ~kPending) == 0 &&
+               word_.compare_exchange_strong(word, kWriter, std::memory_order_acquire,
+                                             std::memory_order_relaxed);
+    }
+
+    void unlock() { word_.fetch_and(~kWriter, std::memory_order_release); }
+
+    void lock_shared() {
+        SpinBackoff backoff;
+        while (!try_lock_shared()) {
+            backoff.wait();
+        }
+    }
+
+    bool try_lock_shared() {
+        uint32_t word = word_.load(std::memory_order_relaxed);
+        while (!(word & (kWriter | kPending))) {
+            if (word_.compare_exchange_weak(word, word + kReader, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void unlock_shared() { word_.fetch_sub(kReader, std::memory_order_release); }
+
+  private:
+    static constexpr uint32_t kWriter  = 1;
+    static constexpr uint32_t kPending = 2;
+    static constexpr uint32_t kReader  = 4;
+
+    std::atomic<uint32_t> word_{0};
+};
+
+namespace detail {
+
+/**
+ * Visible readers table shared by all BRAVO locks.
+ * A fast path reader publishes the address of its lock in a slot chosen by
+ * hashing the lock and the thread, the slots it holds are remembered per thread.
+ */
+class BravoReaders {
+  public:
+    static constexpr size_t kSlots        = 4096;
+    static constexpr size_t kMaxHeldLocks = 16;
+
+    static BravoReaders& get() {
+        static BravoReaders table;
+        return table;
+    }
+
+    std::atomic<const void*>& slot(size_t nr) { return slots_[nr]; }
+
+    static size_t slotOf(const void* lock) {
+        thread_local const size_t thread_id = next_thread_id_.fetch_add(1);
+        return mixHash(uintptr_t(lock) ^ (thread_id << 48u)) & (kSlots - 1);
+    }
+
+    struct Held {
+        const void* lock;
+        size_t      slot;
+    };
+
+    /// Fast path acquisitions of the calling thread
+    static Held* held(size_t*& count) {
+        thread_local Held   held[kMaxHeldLocks];
+        thread_local size_t held_count = 0;
+        count                          = &held_count;
+        return held;
+    }
+
+  private:
+    std::atomic<const void*>          slots_[kSlots] = {};
+    static inline std::atomic<size_t> next_thread_id_{0};
+};
+
+} // namespace detail
+
+/**
+ * # BravoLock
+ * Reader-biased wrapper of a reader-writer lock (Dice, Kogan,
+ * "BRAVO: Biased Locking for Reader-Writer Locks", 2019).
+ *
+ * While the lock is reader-biased, lock_shared() only publishes the lock
+ * in the global visible readers table, so readers of one lock don't share
+ * a cache line. A writer revokes the bias and waits until published readers
+ * of its lock leave the table. The bias is restored by a slow path reader
+ * after 9 times the revocation time, so write-heavy locks stay on the underlying lock.
+ */
+template <typename RWLockT>
+class BravoLock {
+    using readers_t = detail::BravoReaders;
+
+  public:
+    void lock() {
+        underlying_.lock();
+        revokeBias();
+    }
+
+    bool try_lock() {
+        if (!underlying_.try_lock()) {
+            return false;
+        }
+        revokeBias();
+        return true;
+    }
+
+    void unlock() { underlying_.unlock(); }
+
+    void lock_shared() {
+        if (tryLockFast()) {
+            return;
+        }
+        underlying_.lock_shared();
+        restoreBias();
+    }
+
+    bool try_lock_shared() {
+        if (tryLockFast()) {
+            return true;
+        }
+        if (!underlying_.try_lock_shared()) {
+            return false;
+        }
+        restoreBias();
+        return true;
+    }
+
+    void unlock_shared() {
+        size_t* count;
+        auto*   held = readers_t::held(count);
+        for (size_t i = *count; i > 0; i--) {
+            if (held[i - 1].lock == this) {
+                readers_t::get().slot(held[i - 1].slot).store(nullptr, std::memory_order_release);
+                held[i - 1] = held[--*count];
+                return;
+            }
+        }
+        underlying_.unlock_shared();
+    }
+
+  private:
+    static constexpr uint32_t kInhibitMultiplier = 9;
+
+    bool tryLockFast() {
+        if (!reader_bias_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        size_t* count;
+        auto*   held = readers_t::held(count);
+        if (*count == readers_t::kMaxHeldLocks) {
+            return false;
+        }
+
+        size_t      slot     = readers_t::slotOf(this);
+        auto&       entry    = readers_t::get().slot(slot);
+        const void* expected = nullptr;
+        if (!entry.compare_exchange_strong(expected, this)) {
+            return false;
+        }
+        // Pairs with the bias revocation of a writer, one of them sees the other
+        if (!reader_bias_.load()) {
+            entry.store(nullptr, std::memory_order_relaxed);
+            return false;
+        }
+        held[(*count)++] = {this, slot};
+        return true;
+    }
+
+    /// Holder of the write lock waits for fast path readers
+    void revokeBias() {
+        if (!reader_bias_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        reader_bias_.store(false);
+
+        uint32_t start = now();
+        auto&    table = readers_t::get();
+        for (size_t i = 0; i < readers_t::kSlots; i++) {
+            SpinBackoff backoff;
+            while (table.slot(i).load() == this) {
+                backoff.wait();
+            }
+        }
+        uint32_t end = now();
+        inhibit_until_.store(end + (end - start + 1) * kInhibitMultiplier,
+                             std::memory_order_relaxed);
+    }
+
+    /// Holder of a read lock enables the bias again once the inhibition is over
+    void restoreBias() {
+        if (!reader_bias_.load(std::memory_order_relaxed) &&
+            int32_t(now() - inhibit_until_.load(std::memory_order_relaxed)) >= 0) {
+            reader_bias_.store(true, std::memory_order_release);
+        }
+    }
+
+    /// Wrapping time in ~1us units, enough to keep the lock small
+    static uint32_t now() {
+        return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count() >>
+                        10u);
+    }
+
+    RWLockT               underlying_;
+    std::atomic<bool>     reader_bias_{true};
+    std::atomic<uint32_t> inhibit_until_{0};
+};
+
+using BravoRWLock = BravoLock<RWSpinLock>;
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    LlcMisses,
+    DtlbMisses,
+    BranchMisses,
+    ContextSwitches,
+    Count
+};
+
+constexpr int kPerfEventCount = int(PerfEvent::Count);
+
+/**
+ * Counter values of several threads or runs.
+ * A counter is valid only if every contributing thread managed to open it.
+ */
+struct PerfCounts {
+    std::array<double, kPerfEventCount> values{};
+    std::array<bool, kPerfEventCount>   valid{};
+    bool                                empty = true;
+
+    static const char* name(int event) {
+        static const char* names[] = {"cycles",      "instructions",  "llc_misses",
+                                      "dtlb_misses", "branch_misses", "context_switches"};
+        return names[event];
+    }
+
+    PerfCounts& operator+=(const PerfCounts& other) {
+        for (int i = 0; i < kPerfEventCount; i++) {
+            values[i] += other.values[i];
+            valid[i] = (empty || valid[i]) && other.valid[i];
+        }
+        empty = empty && other.empty;
+        return *this;
+    }
+
+    /// Writes "a, b, ..." with values per operation, NA for unavailable counters
+    void printPerOp(std::ostream& out, size_t ops) const {
+        for (int i = 0; i < kPerfEventCount; i++) {
+            out << (i ? ", " : "");
+            if (valid[i] && ops) {
+                out << values[i] / ops;
+            } else {
+                out << "NA";
+            }
+        }
+    }
+
+    /// Writes "name=value ..." per operation for the console
+    void printSummary(std::ostream& out, size_t ops) const {
+        for (int i = 0; i < kPerfEventCount; i++) {
+            out << (i ? " " : "") << name(i) << "=";
+            if (valid[i] && ops) {
+                out << values[i] / ops;
+            } else {
+                out << "NA";
+            }
+        }
+    }
+
+    static void printHeader(std::ostream& out) {
+        for (int i = 0; i < kPerfEventCount; i++) {
+            out << (i ? ", " : "") << name(i) << "_per_op";
+        }
+    }
+};
+
+/**
+ * # PerfCounters
+ * perf_event_open counters of the calling thread (user space only).
+ *
+ * Counters that can't be opened (no PMU in a VM or container,
+ * perf_event_paranoid, seccomp) are reported as invalid,
+ * the benchmark itself is never affected.
+ * Values are scaled by enabled/running time in case the kernel multiplexes them.
+ */
+class PerfCounters {
+  public:
+    PerfCounters() {
+        fds_.fill(-1);
+        for (int i = 0; i < kPerfEventCount; i++) {
+            fds_[i] = open(PerfEvent(i));
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    void start() {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    void stop() {
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+    }
+
+    PerfCounts read() const {
+        PerfCounts res;
+        res.empty = false;
+        for (int i = 0; i < kPerfEventCount; i++) {
+            // value, time_enabled, time_running
+            uint64_t data[3];
+            if (fds_[i] < 0 || ::read(fds_[i], data, sizeof(data)) != sizeof(data)) {
+                continue;
+            }
+            res.valid[i]  = true;
+            res.values[i] = data[2] ? double(data[0]) * data[1] / data[2] : 0;
+        }
+        return res;
+    }
+
+  private:
+    static int open(PerfEvent event) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        auto cacheMiss = [](uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+
+        switch (event) {
+        case PerfEvent::Cycles:
+            attr.type   = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::Instructions:
+            attr.type   = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::LlcMisses:
+            attr.type   = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+            break;
+        case PerfEvent::DtlbMisses:
+            attr.type   = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB);
+            break;
+        case PerfEvent::BranchMisses:
+            attr.type   = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PerfEvent::ContextSwitches:
+            // Switches happen in the kernel, they are not counted with exclude_kernel
+            attr.type           = PERF_TYPE_SOFTWARE;
+            attr.config         = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            attr.exclude_kernel = 0;
+            break;
+        default:
+            return -1;
+        }
+
+        return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    std::array<int, kPerfEventCount> fds_;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "utility.h"
+
+/**
+ * Operation and hit totals of one benchmark thread.
+ * Only the owning thread writes them, with plain relaxed stores,
+ * so publishing costs about as much as a local increment.
+ */
+struct CACHELINE_ALIGN ThreadOpCounters {
+    static constexpr uint64_t kPublishEvery = 256; ///< operations between publish() calls
+
+    std::atomic<uint64_t> ops{0};
+    std::atomic<uint64_t> hits{0};
+
+    void publish(uint64_t total_ops, uint64_t total_hits) {
+        ops.store(total_ops, std::memory_order_relaxed);
+        hits.store(total_hits, std::memory_order_relaxed);
+    }
+};
+
+/// Counters of one sampling interval
+struct TimeSeriesSample {
+    double            time;     ///< seconds since the sampling started, end of the interval
+    double            interval; ///< seconds
+    uint64_t          ops;
+    uint64_t          hits;
+    ProfileStatsSlice perf; ///< difference over the interval, evictions only with --profile
+    MemStats          mem;  ///< at the end of the interval
+};
+
+/**
+ * # TimeSeriesWriter
+ * Appends samples to a CSV file, or to JSON lines if the name ends in ".jsonl".
+ * Every row repeats the run name, container and thread count,
+ * so the series of several runs can share a file like the summary log.
+ */
+class TimeSeriesWriter {
+  public:
+    TimeSeriesWriter(const std::string& filename, std::string run_name, std::string container,
+                     unsigned threads)
+        : json_(filename.size() >= 6 && filename.compare(filename.size() - 6, 6, ".jsonl") == 0),
+          output_(filename, std::fstream::out | std::fstream::app), run_name_(std::move(run_name)),
+          container_(std::move(container)), threads_(threads) {
+        if (!output_.is_open()) {
+            throw std::runtime_error("Can't open time series file " + filename);
+        }
+        if (!json_ && output_.tellp() == 0) {
+            output_ << "test_name, container, threads, time, interval, ops, throughput, hit_rate, "
+                       "evict_rate, count, capacity, used_mem, total_mem\n";
+        }
+    }
+
+    void write(const TimeSeriesSample& s) {
+        double throughput = s.ops / s.interval;
+        double hit_rate   = s.ops ? double(s.hits) / s.ops : 0;
+        if (json_) {
+            output_ << "{\"test_name\": \"" << run_name_ << "\", \"container\": \"" << container_
+                    << "\", \"threads\": " << threads_ << ", \"time\": " << s.time
+                    << ", \"interval\": " << s.interval << ", \"ops\": " << s.ops
+                    << ", \"throughput\": " << throughput << ", \"hit_rate\": " << hit_rate
+                    << ", \"evict_rate\": ";
+            if (s.perf.enabled) {
+                output_ << s.perf.evict / s.interval;
+            } else {
+                output_ << "null";
+            }
+            output_ << ", \"count\": " << s.mem.count << ", \"capacity\": " << s.mem.capacity
+                    << ", \"used_mem\": " << s.mem.used_mem
+                    << ", \"total_mem\": " << s.mem.total_mem << "}\n";
+        } else {
+            output_ << run_name_ << ", " << container_ << ", " << threads_ << ", " << s.time
+                    << ", " << s.interval << ", " << s.ops << ", " << throughput << ", "
+                    << hit_rate << ", ";
+            if (s.perf.enabled) {
+                output_ << s.perf.evict / s.interval;
+            } else {
+                output_ << "NA";
+            }
+            output_ << ", " << s.mem.count << ", " << s.mem.capacity << ", " << s.mem.used_mem
+                    << ", " << s.mem.total_mem << "\n";
+        }
+        output_.flush();
+    }
+
+  private:
+    bool          json_;
+    std::ofstream output_;
+    std::string   run_name_;
+    std::string   container_;
+    unsigned      threads_;
+};
+
+/**
+ * # RunSampler
+ * Background thread that turns the ThreadOpCounters of a run into a time series.
+ *
+ * Every interval it sums the published totals of all threads and writes
+ * the difference to the previous sample together with the profile
+ * and memory statistics of the container. Container statistics are read
+ * without synchronization with the workers, so they are approximate.
+ */
+template <typename Container>
+class RunSampler {
+  public:
+    RunSampler(const Container& cont, unsigned threads, double interval, TimeSeriesWriter& writer)
+        : cont_(cont), counters_(new ThreadOpCounters[threads]), threads_(threads),
+          interval_(interval), writer_(writer) {
+        if (interval <= 0) {
+            throw std::runtime_error("Sampling interval must be positive");
+        }
+    }
+
+    RunSampler(const RunSampler&) = delete;
+
+    ~RunSampler() { stop(); }
+
+    ThreadOpCounters& counters(unsigned thread) { return counters_[thread]; }
+
+    void start() {
+        start_   = std::chrono::steady_clock::now();
+        last_    = {start_, 0, 0, cont_.profileStats()};
+        stopped_ = false;
+        thread_  = std::thread([this] { run(); });
+    }
+
+    /// Writes the last, possibly shorter interval and joins the thread
+    void stop() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            stopped_ = true;
+        }
+        wakeup_.notify_one();
+        thread_.join();
+        sample();
+    }
+
+  private:
+    struct Totals {
+        std::chrono::steady_clock::time_point time;
+        uint64_t                              ops;
+        uint64_t                              hits;
+        ProfileStatsSlice                     perf;
+    };
+
+    static ProfileStatsSlice difference(ProfileStatsSlice a, const ProfileStatsSlice& b) {
+        a.find -= b.find;
+        a.insert -= b.insert;
+        a.head_accesses -= b.head_accesses;
+        a.evict -= b.evict;
+        return a;
+    }
+
+    void run() {
+        auto                         period = std::chrono::duration<double>(interval_);
+        auto                         next   = start_;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+            if (wakeup_.wait_until(lock, next, [this] { return stopped_; })) {
+                return;
+            }
+            sample();
+        }
+    }
+
+    void sample() {
+        Totals now{std::chrono::steady_clock::now(), 0, 0, cont_.profileStats()};
+        for (unsigned t = 0; t < threads_; t++) {
+            now.ops += counters_[t].ops.load(std::memory_order_relaxed);
+            now.hits += counters_[t].hits.load(std::memory_order_relaxed);
+        }
+
+        TimeSeriesSample s;
+        s.time     = std::chrono::duration<double>(now.time - start_).count();
+        s.interval = std::chrono::duration<double>(now.time - last_.time).count();
+        s.ops      = now.ops - last_.ops;
+        s.hits     = now.hits - last_.hits;
+        s.perf     = difference(now.perf, last_.perf);
+        s.mem      = cont_.memStats();
+        if (s.interval > 0) {
+            writer_.write(s);
+        }
+        last_ = now;
+    }
+
+    const Container&                    cont_;
+    std::unique_ptr<ThreadOpCounters[]> counters_;
+    unsigned                            threads_;
+    double                              interval_;
+    TimeSeriesWriter&                   writer_;
+
+    std::chrono::steady_clock::time_point start_;
+    Totals                                last_{};
+    std::thread                           thread_;
+    std::mutex                            mutex_;
+    std::condition_variable               wakeup_;
+    bool                                  stopped_ = false;
+};
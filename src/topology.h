@@ -0,0 +1,350 @@
+#pragma once
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/// Parses a kernel cpu or node list, e.g. "0-3,8-11".
+inline std::vector<unsigned> parseCpuList(const std::string& list) {
+    std::vector<unsigned> res;
+    size_t                pos = 0;
+    while (pos < list.size()) {
+        size_t end   = list.find(',', pos);
+        auto   range = list.substr(pos, end == std::string::npos ? end : end - pos);
+        size_t dash  = range.find('-');
+        auto   first = unsigned(std::stoul(range.substr(0, dash)));
+        auto   last  = first;
+        if (dash != std::string::npos) {
+            last = unsigned(std::stoul(range.substr(dash + 1)));
+        }
+        for (unsigned i = first; i <= last; i++) {
+            res.push_back(i);
+        }
+        pos = end == std::string::npos ? list.size() : end + 1;
+    }
+    return res;
+}
+
+/// @return list from a sysfs file, empty if it does not exist
+inline std::vector<unsigned> readCpuList(const std::string& path) {
+    std::ifstream in(path);
+    std::string   list;
+    if (!(in >> list)) {
+        return {};
+    }
+    return parseCpuList(list);
+}
+
+/// Formats CPUs as ranges joined by '+', e.g. "0-3+8", so the result fits a CSV field.
+inline std::string formatCpuList(std::vector<unsigned> cpus) {
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    std::string res;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        res += (res.empty() ? "" : "+") + std::to_string(cpus[i]);
+        if (j != i) {
+            res += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return res;
+}
+
+struct CpuInfo {
+    unsigned cpu;
+    unsigned node;    ///< dense node index
+    unsigned package;
+    unsigned core;    ///< core id within the package
+    unsigned smt;     ///< position among SMT siblings of the core, 0 for the first one
+};
+
+/**
+ * # CpuTopology
+ * Online CPUs grouped by NUMA node and physical core, as reported by sysfs.
+ *
+ * Nodes are numbered densely from 0, nodeId() gives the kernel node id.
+ * A machine without NUMA information is a single node with all online CPUs,
+ * a CPU without topology information is a separate core.
+ */
+class CpuTopology {
+  public:
+    static const CpuTopology& get() {
+        static CpuTopology topology;
+        return topology;
+    }
+
+    size_t nodeCount() const { return node_cpus_.size(); }
+
+    unsigned nodeId(size_t node) const { return node_ids_[node]; }
+
+    const std::vector<unsigned>& nodeCpus(size_t node) const { return node_cpus_[node]; }
+
+    const std::vector<unsigned>& cpus() const { return cpus_; }
+
+    /// Online CPUs ordered by node, package, core and SMT sibling
+    const std::vector<CpuInfo>& cpuInfo() const { return cpu_info_; }
+
+    size_t coreCount() const { return core_count_; }
+
+    /// @return one past the largest online CPU number
+    size_t cpuLimit() const { return cpu_node_.size(); }
+
+    unsigned nodeOfCpu(unsigned cpu) const { return cpu < cpu_node_.size() ? cpu_node_[cpu] : 0; }
+
+    /// NUMA node of the CPU the calling thread currently runs on
+    unsigned currentNode() const {
+        int cpu = sched_getcpu();
+        return cpu < 0 ? 0 : nodeOfCpu(unsigned(cpu));
+    }
+
+  private:
+    CpuTopology() {
+        cpus_ = readCpuList("/sys/devices/system/cpu/online");
+        if (cpus_.empty()) {
+            cpus_.push_back(0);
+        }
+        cpu_node_.assign(*std::max_element(cpus_.begin(), cpus_.end()) + 1, 0);
+
+        for (unsigned id : readCpuList("/sys/devices/system/node/online")) {
+            auto node_cpus =
+                readCpuList("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            node_cpus.erase(std::remove_if(node_cpus.begin(), node_cpus.end(),
+                                           [this](unsigned cpu) {
+                                               return !std::binary_search(cpus_.begin(),
+                                                                          cpus_.end(), cpu);
+                                           }),
+                            node_cpus.end());
+            if (node_cpus.empty()) {
+                // Memory-only node
+                continue;
+            }
+            for (unsigned cpu : node_cpus) {
+                cpu_node_[cpu] = unsigned(node_cpus_.size());
+            }
+            node_ids_.push_back(id);
+            node_cpus_.push_back(std::move(node_cpus));
+        }
+
+        if (node_cpus_.empty()) {
+            node_ids_.push_back(0);
+            node_cpus_.push_back(cpus_);
+        }
+
+        for (unsigned cpu : cpus_) {
+            auto   dir      = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            auto   siblings = readCpuList(dir + "thread_siblings_list");
+            size_t smt      = std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin();
+            cpu_info_.push_back({cpu, nodeOfCpu(cpu), readNumber(dir + "physical_package_id", 0),
+                                 readNumber(dir + "core_id", cpu),
+                                 unsigned(smt == siblings.size() ? 0 : smt)});
+        }
+        auto key = [](const CpuInfo& c) { return std::tie(c.node, c.package, c.core, c.smt); };
+        std::sort(cpu_info_.begin(), cpu_info_.end(),
+                  [&key](const CpuInfo& a, const CpuInfo& b) { return key(a) < key(b); });
+        for (size_t i = 0; i < cpu_info_.size(); i++) {
+            if (i == 0 || cpu_info_[i].package != cpu_info_[i - 1].package ||
+                cpu_info_[i].core != cpu_info_[i - 1].core) {
+                core_count_++;
+            }
+        }
+    }
+
+    static unsigned readNumber(const std::string& path, unsigned fallback) {
+        std::ifstream in(path);
+        unsigned      res;
+        return in >> res ? res : fallback;
+    }
+
+    std::vector<unsigned>              cpus_;
+    std::vector<unsigned>              cpu_node_;
+    std::vector<unsigned>              node_ids_;
+    std::vector<std::vector<unsigned>> node_cpus_;
+    std::vector<CpuInfo>               cpu_info_;
+    size_t                             core_count_ = 0;
+};
+
+/// Restricts the calling thread to the given CPUs.
+/// @return false if the affinity can't be set
+inline bool pinCurrentThread(const std::vector<unsigned>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+enum class PinPolicy {
+    None,      ///< threads are scheduled by the OS
+    Compact,   ///< consecutive threads on neighbouring CPUs, filling a node before the next one
+    Scatter,   ///< consecutive threads round-robin over nodes
+    PerSocket, ///< threads are split evenly over nodes, each may run on any CPU of its node
+    List       ///< consecutive threads on consecutive CPUs of an explicit list
+};
+
+/**
+ * # ThreadPinning
+ * Assignment of benchmark threads to CPUs.
+ *
+ * With avoid_smt only the first SMT sibling of each core is used,
+ * otherwise siblings are used only after every core has a thread (Scatter)
+ * or right after their first sibling (Compact).
+ * Threads wrap around if there are more threads than CPUs.
+ */
+struct ThreadPinning {
+    PinPolicy             policy    = PinPolicy::None;
+    bool                  avoid_smt = false;
+    std::vector<unsigned> cpu_list; ///< List only
+
+    static PinPolicy parsePolicy(const std::string& s) {
+        if (s == "none") {
+            return PinPolicy::None;
+        } else if (s == "compact") {
+            return PinPolicy::Compact;
+        } else if (s == "scatter") {
+            return PinPolicy::Scatter;
+        } else if (s == "per-socket") {
+            return PinPolicy::PerSocket;
+        } else if (s == "list") {
+            return PinPolicy::List;
+        }
+        throw std::runtime_error("Unknown pinning policy: " + s);
+    }
+
+    static const char* policyName(PinPolicy policy) {
+        switch (policy) {
+        case PinPolicy::None:
+            return "none";
+        case PinPolicy::Compact:
+            return "compact";
+        case PinPolicy::Scatter:
+            return "scatter";
+        case PinPolicy::PerSocket:
+            return "per-socket";
+        case PinPolicy::List:
+            return "list";
+        }
+        return "";
+    }
+
+    /// @return CPU set for each thread, empty if threads are not pinned
+    std::vector<std::vector<unsigned>> plan(unsigned thread_count) const {
+        const auto&                        topology = CpuTopology::get();
+        std::vector<std::vector<unsigned>> res;
+        if (policy == PinPolicy::None) {
+            return res;
+        }
+        if (policy == PinPolicy::PerSocket) {
+            for (unsigned t = 0; t < thread_count; t++) {
+                size_t                node = size_t(t) * topology.nodeCount() / thread_count;
+                std::vector<unsigned> cpus;
+                for (const auto& c : topology.cpuInfo()) {
+                    if (c.node == node && (!avoid_smt || c.smt == 0)) {
+                        cpus.push_back(c.cpu);
+                    }
+                }
+                res.push_back(std::move(cpus));
+            }
+            return res;
+        }
+
+        auto order = cpuOrder();
+        if (order.empty()) {
+            throw std::runtime_error("No CPUs to pin threads to");
+        }
+        for (unsigned t = 0; t < thread_count; t++) {
+            res.push_back({order[t % order.size()]});
+        }
+        return res;
+    }
+
+    /// Policy, machine (nodes/cores/CPUs) and CPUs in use, e.g. "scatter-nosmt 2n/48c/96t 0-47"
+    std::string describe(unsigned thread_count) const {
+        const auto& topology = CpuTopology::get();
+        std::string res      = policyName(policy);
+        if (avoid_smt && policy != PinPolicy::None) {
+            res += "-nosmt";
+        }
+        res += " " + std::to_string(topology.nodeCount()) + "n/" +
+               std::to_string(topology.coreCount()) + "c/" +
+               std::to_string(topology.cpus().size()) + "t";
+        std::vector<unsigned> used;
+        for (const auto& cpus : plan(thread_count)) {
+            used.insert(used.end(), cpus.begin(), cpus.end());
+        }
+        if (!used.empty()) {
+            res += " " + formatCpuList(used);
+        }
+        return res;
+    }
+
+  private:
+    std::vector<unsigned> cpuOrder() const {
+        const auto&           topology = CpuTopology::get();
+        std::vector<unsigned> res;
+        if (policy == PinPolicy::List) {
+            for (unsigned cpu : cpu_list) {
+                if (!avoid_smt || isFirstSibling(cpu)) {
+                    res.push_back(cpu);
+                }
+            }
+            return res;
+        }
+
+        unsigned max_smt = 0;
+        for (const auto& c : topology.cpuInfo()) {
+            max_smt = std::max(max_smt, c.smt);
+        }
+        if (avoid_smt) {
+            max_smt = 0;
+        }
+
+        if (policy == PinPolicy::Compact) {
+            for (const auto& c : topology.cpuInfo()) {
+                if (c.smt <= max_smt) {
+                    res.push_back(c.cpu);
+                }
+            }
+            return res;
+        }
+
+        // Scatter: one SMT level at a time, round-robin over nodes
+        for (unsigned smt = 0; smt <= max_smt; smt++) {
+            std::vector<std::vector<unsigned>> per_node(topology.nodeCount());
+            for (const auto& c : topology.cpuInfo()) {
+                if (c.smt == smt) {
+                    per_node[c.node].push_back(c.cpu);
+                }
+            }
+            for (size_t i = 0, added = 1; added; i++) {
+                added = 0;
+                for (const auto& cpus : per_node) {
+                    if (i < cpus.size()) {
+                        res.push_back(cpus[i]);
+                        added++;
+                    }
+                }
+            }
+        }
+        return res;
+    }
+
+    static bool isFirstSibling(unsigned cpu) {
+        for (const auto& c : CpuTopology::get().cpuInfo()) {
+            if (c.cpu == cpu) {
+                return c.smt == 0;
+            }
+        }
+        return true;
+    }
+};
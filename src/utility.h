@@ -1,6 +1,8 @@
 #pragma once
 
 #include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <ostream>
 #include <string>
 
@@ -98,6 +100,57 @@ inline std::string prettyPrintSize(size_t size) {
     return {buff};
 }
 
+/**
+ * Splitmix64 finalizer. Spreads entropy of all key bits over
+ * the whole word, so any subset of bits can be used as a table index.
+ */
+inline size_t mixHash(size_t x) {
+    x = (x ^ (x >> 30u)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27u)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31u);
+}
+
+inline size_t roundUpToPowerOfTwo(size_t x) {
+    size_t res = 1;
+    while (res < x) {
+        res <<= 1u;
+    }
+    return res;
+}
+
+/// Largest power of two not above x, x must not be zero
+inline size_t roundDownToPowerOfTwo(size_t x) {
+    return size_t(1) << (sizeof(unsigned long) * 8 - 1 - __builtin_clzl(x));
+}
+
+/**
+ * Smallest power of two bucket count that keeps
+ * element count per bucket within load_factor.
+ */
+inline size_t bucketCountForLoadFactor(size_t element_count, double load_factor) {
+    return roundUpToPowerOfTwo(size_t(std::ceil(element_count / load_factor)));
+}
+
+/**
+ * Bucket of a hash in a linear hashing table of count buckets.
+ * The table grows by splitting one bucket at a time: with level the largest
+ * power of two not above count, buckets [0, count - level) are already split
+ * into themselves and [level, count). For count a power of two it is hash & (count - 1).
+ */
+inline size_t linearHashBucket(size_t hash, size_t count) {
+    size_t level = roundDownToPowerOfTwo(count);
+    size_t nr    = hash & (2 * level - 1);
+    return nr < count ? nr : nr - level;
+}
+
+/**
+ * Share i of total split into parts nearly equal shares,
+ * the first total % parts shares get one more so they sum up to total.
+ */
+inline size_t evenShare(size_t total, size_t parts, size_t i) {
+    return total / parts + (i < total % parts ? 1 : 0);
+}
+
 template <typename Number>
 std::string prettyPrintRatio(Number x, Number total) {
     if (total == 0) {